@@ -10,7 +10,7 @@ function(add_shader TARGET SHADER)
 
     add_custom_command(
            OUTPUT ${SHADER_OUTPUT_PATH}
-           COMMAND ${GLSLC} ${SHADER_SOURCE_PATH} -o ${SHADER_OUTPUT_PATH}
+           COMMAND ${GLSLC} ${ARGN} ${SHADER_SOURCE_PATH} -o ${SHADER_OUTPUT_PATH}
            DEPENDS ${SHADER}
            VERBATIM)
 
@@ -1,6 +1,8 @@
 #include "application.h"
 #include "debug_messenger.h"
 #include "utility.h"
+#include "mesh_deduplication.h"
+#include "bc7_encoder.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -12,17 +14,25 @@
 #include <tiny_obj_loader.h>
 
 #include <iostream>
-#include <unordered_map>
 #include <chrono>
 #include <vector>
 #include <set>
 #include <cstring>
+#include <cmath>
+#include <atomic>
+#include <filesystem>
+#include <utility>
+#include <thread>
 
 constexpr uint32_t window_width = 800;
 constexpr uint32_t window_height = 600;
 const std::string application_name = "hello-triangle";
 const std::string model_path = "resources/viking_room.obj";
+const std::string mesh_cache_path = "resources/viking_room.meshcache";
+const std::string pipeline_cache_path = "pipeline_cache.bin";
 const std::string texture_path = "resources/viking_room.png";
+const std::string bc7_texture_cache_path = "resources/viking_room.bc7.texcache";
+const std::string rgba8_texture_cache_path = "resources/viking_room.rgba8.texcache";
 
 #ifdef NDEBUG
     constexpr bool enable_validation_layers = false;
@@ -30,72 +40,255 @@ const std::string texture_path = "resources/viking_room.png";
     constexpr bool enable_validation_layers = true;
 #endif
 
-constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+// Uploads that do not fit fall back to a temporary staging buffer
+constexpr VkDeviceSize staging_ring_size = 32ull * 1024 * 1024;
 
-Application::Application() {
-    init_glfw();
-    load_model();
+// Satisfies the texel size and optimalBufferCopyOffsetAlignment of every format we upload
+constexpr VkDeviceSize staging_alignment = 16;
+
+// Coarser levels of detail are drawn while their error projects to at most this many pixels
+constexpr float lod_pixel_error = 1.0f;
+
+// Meshlets culled by one task shader workgroup, local_size_x of meshlet.task
+constexpr uint32_t meshlets_per_task_group = 32;
+
+// Cluster culling commands for every meshlet of every instance of every draw, per frame in
+// flight. Scenes that would need more cull whole instances instead
+constexpr VkDeviceSize max_cluster_command_bytes = 64ull * 1024 * 1024;
+
+#ifndef GIT_COMMIT
+    #define GIT_COMMIT "unknown"
+#endif
+
+Application::Application(const Settings& _settings) : settings(_settings) {
+    if (!settings.headless) {
+        init_glfw();
+    }
+    if (!settings.async_assets) {
+        load_model();
+    }
+
+    auto init_start = std::chrono::steady_clock::now();
     init_vulkan();
+    startup_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - init_start).count();
+
+    std::cout << "Vulkan initialized in " << std::fixed << std::setprecision(2) << startup_milliseconds
+              << " ms, pipelines created in " << pipeline_creation_milliseconds << " ms (pipeline cache "
+              << (pipeline_cache_warm ? "warm" : "cold") << ")\n\n";
 }
 
 void Application::run() {
-    while (!glfwWindowShouldClose(window)) {
+    run_start_time = std::chrono::steady_clock::now();
+    last_report_time = run_start_time;
+    next_frame_time = run_start_time;
+
+    // Measurements would otherwise start with placeholder frames
+    if (settings.benchmark_frames != 0) {
+        finish_asset_streaming();
+    }
+
+    while (!should_close()) {
+        if (settings.fps_limit != 0) {
+            pace_frame();
+        }
+
         static auto start_time = std::chrono::high_resolution_clock::now();
         auto current_time = std::chrono::high_resolution_clock::now();
         time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
 
-        glfwPollEvents();
+        if (!settings.headless) {
+            glfwPollEvents();
+        }
+        input_time = std::chrono::steady_clock::now();
 
         draw_frame();
+        report_frame_rate(false);
     }
 
     vkDeviceWaitIdle(device);
+    report_frame_rate(true);
+
+    if (settings.benchmark_frames != 0) {
+        write_benchmark_report();
+    }
+}
+
+void Application::pace_frame() {
+    auto frame_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / settings.fps_limit));
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_frame_time) {
+        std::this_thread::sleep_until(next_frame_time);
+        if (is_benchmark_recording()) {
+            benchmark.add_sample("pacing_sleep", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - now).count());
+        }
+        now = next_frame_time;
+    }
+
+    // A late frame moves the schedule instead of being followed by frames rendered back to back
+    next_frame_time = now + frame_period;
+}
+
+bool Application::should_close() {
+    if (settings.frame_count != 0 && frames_rendered >= settings.frame_count) {
+        return true;
+    }
+
+    if (settings.headless) {
+        return false;
+    }
+
+    return glfwWindowShouldClose(window);
+}
+
+void Application::report_frame_rate(bool final_report) {
+    auto now = std::chrono::steady_clock::now();
+
+    if (final_report) {
+        double total_seconds = std::chrono::duration<double>(now - run_start_time).count();
+        std::cout << "Rendered " << frames_rendered << " frames in " 
+                  << std::fixed << std::setprecision(2) << total_seconds << " s ("
+                  << frames_rendered / total_seconds << " FPS)" << std::endl;
+        return;
+    }
+
+    // Reported once per second, the first frames are not skipped
+    double elapsed_seconds = std::chrono::duration<double>(now - last_report_time).count();
+    if (elapsed_seconds < 1.0 || frames_since_report == 0) return;
+
+    std::cout << "FPS: " << std::fixed << std::setprecision(1) << frames_since_report / elapsed_seconds
+              << " (" << std::setprecision(3) << 1000.0 * elapsed_seconds / frames_since_report << " ms/frame)" << std::endl;
+
+    frames_since_report = 0;
+    last_report_time = now;
 }
 
 Application::~Application() {
+    // The loading job uses members, and a streaming upload may still own staging buffers
+    if (asset_loading.valid()) {
+        asset_loading.wait();
+    }
+    wait_for_uploads();
+
+    destroy_retired_render_targets(UINT64_MAX);
     cleanup_swap_chain();
 
-    vkDestroyPipeline(device, graphics_pipeline, nullptr);
+    // Variants still compiling are waited for, so they are part of the saved cache
+    pipeline_library.destroy();
+    vkDestroyShaderModule(device, frag_shader_module, nullptr);
+    vkDestroyShaderModule(device, vert_shader_module, nullptr);
+    vkDestroyShaderModule(device, task_shader_module, nullptr);
+    vkDestroyShaderModule(device, mesh_shader_module, nullptr);
+
+    save_pipeline_cache();
+    vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+
+    if (settings.gpu_culling) {
+        vkDestroyPipeline(device, cull_pipeline, nullptr);
+        vkDestroyPipeline(device, cluster_cull_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, cull_pipeline_layout, nullptr);
+        vkDestroyDescriptorSetLayout(device, cull_descriptor_set_layout, nullptr);
+    }
+    vkDestroyDescriptorSetLayout(device, meshlet_descriptor_set_layout, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
     vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
-    vkDestroyRenderPass(device, render_pass, nullptr);
+    for (auto _render_pass : render_passes) {
+        vkDestroyRenderPass(device, _render_pass, nullptr);
+    }
 
     vkDestroyBuffer(device, vertex_buffer, nullptr);
-    vkFreeMemory(device, vertex_buffer_memory, nullptr);
+    allocator.free(vertex_buffer_allocation);
     vkDestroyBuffer(device, index_buffer, nullptr);
-    vkFreeMemory(device, index_buffer_memory, nullptr);
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    allocator.free(index_buffer_allocation);
+    vkDestroyBuffer(device, instance_buffer, nullptr);
+    allocator.free(instance_buffer_allocation);
+    vkDestroyBuffer(device, indirect_buffer, nullptr);
+    allocator.free(indirect_buffer_allocation);
+    vkDestroyBuffer(device, meshlet_buffer, nullptr);
+    allocator.free(meshlet_buffer_allocation);
+    vkDestroyBuffer(device, meshlet_vertex_buffer, nullptr);
+    allocator.free(meshlet_vertex_buffer_allocation);
+    vkDestroyBuffer(device, meshlet_triangle_buffer, nullptr);
+    allocator.free(meshlet_triangle_buffer_allocation);
+    vkDestroyBuffer(device, lod_buffer, nullptr);
+    allocator.free(lod_buffer_allocation);
+    if (settings.gpu_culling) {
+        vkDestroyBuffer(device, draw_placement_buffer, nullptr);
+        allocator.free(draw_placement_buffer_allocation);
+
+        // Missing when the assets never finished streaming
+        for (size_t i = 0; i < culled_indirect_buffers.size(); ++i) {
+            vkDestroyBuffer(device, visible_instance_buffers[i], nullptr);
+            allocator.free(visible_instance_buffers_allocations[i]);
+            vkDestroyBuffer(device, culled_indirect_buffers[i], nullptr);
+            allocator.free(culled_indirect_buffers_allocations[i]);
+            vkDestroyBuffer(device, cull_count_buffers[i], nullptr);
+            allocator.free(cull_count_buffers_allocations[i]);
+        }
+        vkDestroyBuffer(device, cull_command_template_buffer, nullptr);
+        allocator.free(cull_command_template_buffer_allocation);
+    }
+    for (size_t i = 0; i < settings.frames_in_flight; ++i) {
         vkDestroyBuffer(device, uniform_buffers[i], nullptr);
-        vkFreeMemory(device, uniform_buffers_memory[i], nullptr);
+        allocator.free(uniform_buffers_allocations[i]);
     }
 
     vkDestroySampler(device, texture_sampler, nullptr);
     vkDestroyImageView(device, texture_image_view, nullptr);
     vkDestroyImage(device, texture_image, nullptr);
-    vkFreeMemory(device, texture_image_memory, nullptr);
+    allocator.free(texture_image_allocation);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    if (settings.async_assets) {
+        vkDestroyBuffer(device, placeholder_vertex_buffer, nullptr);
+        allocator.free(placeholder_vertex_buffer_allocation);
+        vkDestroyBuffer(device, placeholder_index_buffer, nullptr);
+        allocator.free(placeholder_index_buffer_allocation);
+        vkDestroyImageView(device, placeholder_texture_image_view, nullptr);
+        vkDestroyImage(device, placeholder_texture_image, nullptr);
+        allocator.free(placeholder_texture_image_allocation);
+    }
+
+    for (size_t i = 0; i < settings.frames_in_flight; ++i) {
         vkDestroySemaphore(device, image_available_semaphores[i], nullptr);
         vkDestroySemaphore(device, render_finished_semaphores[i], nullptr);
-        vkDestroyFence(device, in_flight_fences[i], nullptr);
     }
 
     vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+
+    if (timestamp_query_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, timestamp_query_pool, nullptr);
+    }
     
+    vkDestroySemaphore(device, transfer_timeline, nullptr);
+    vkDestroySemaphore(device, gpu_timeline, nullptr);
+    staging_ring.destroy();
+    if (has_dedicated_transfer_queue()) {
+        vkDestroyCommandPool(device, transfer_command_pool, nullptr);
+    }
+    for (auto recording_command_pool : recording_command_pools) {
+        vkDestroyCommandPool(device, recording_command_pool, nullptr);
+    }
     vkDestroyCommandPool(device, command_pool, nullptr);
 
+    allocator.destroy();
+
     vkDestroyDevice(device, nullptr);
 
     if (enable_validation_layers) {
         DestroyDebugUtilsMessengerEXT(instance, debug_messenger, nullptr);
     }
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (!settings.headless) {
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
     vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
+    if (!settings.headless) {
+        glfwDestroyWindow(window);
 
-    glfwTerminate();
+        glfwTerminate();
+    }
 }
 
 void Application::init_glfw() {
@@ -118,6 +311,23 @@ void Application::key_callback(GLFWwindow* window, int key, int scancode, int ac
         glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
 
+    // Only the requested variant changes here, draw_frame switches once it has been compiled
+    auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+    auto& requested_key = app->requested_pipeline_key;
+    if (action == GLFW_PRESS) {
+        if (key == GLFW_KEY_W && app->fill_mode_non_solid) {
+            requested_key.polygon_mode = (requested_key.polygon_mode == VK_POLYGON_MODE_FILL) ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+        } else if (key == GLFW_KEY_D) {
+            requested_key.depth_only = !requested_key.depth_only;
+        } else if (key == GLFW_KEY_B) {
+            requested_key.blended = !requested_key.blended;
+        } else if (key == GLFW_KEY_M) {
+            const auto& counts = app->usable_sample_counts;
+            auto it = std::find(counts.begin(), counts.end(), requested_key.samples);
+            requested_key.samples = (it == counts.end() || it + 1 == counts.end()) ? counts.front() : *(it + 1);
+        }
+    }
+
     (void)scancode;
     (void)mods;
 }
@@ -130,16 +340,203 @@ void Application::framebuffer_resize_callback(GLFWwindow* window, int width, int
 }
 
 void Application::load_model() {
+    auto load_start = std::chrono::steady_clock::now();
+
+    // Hashed and, on a miss, parsed from the same mapping
+    MappedFile model_file(model_path);
+    uint64_t source_hash = hash_file(model_file);
+    mesh_cache_hit = settings.mesh_cache && mesh_cache.load(mesh_cache_path, source_hash, sizeof(Vertex), get_mesh_cache_flags());
+    if (mesh_cache_hit) {
+        vertex_data = mesh_cache.get_vertices();
+        vertex_count = mesh_cache.get_vertex_count();
+        index_data = mesh_cache.get_indices();
+        index_count = mesh_cache.get_index_count();
+
+        lods.clear();
+        auto cached_lods = mesh_cache.get_lods();
+        for (uint32_t i = 0; i < mesh_cache.get_lod_count(); ++i) {
+            lods.push_back({cached_lods[i].first_index, cached_lods[i].index_count, 0, 0, 0, 0, cached_lods[i].error});
+        }
+    } else {
+        parse_model(model_file);
+        vertex_data = vertices.data();
+        vertex_count = static_cast<uint32_t>(vertices.size());
+        index_data = indices.data();
+        index_count = static_cast<uint32_t>(indices.size());
+        build_model_lods();
+
+        if (settings.mesh_cache) {
+            std::vector<MeshCacheLod> cached_lods;
+            for (const auto& lod : lods) {
+                cached_lods.push_back({lod.first_index, lod.index_count, lod.error});
+            }
+
+            try {
+                MeshCache::write(mesh_cache_path, source_hash, sizeof(Vertex), get_mesh_cache_flags(),
+                                 vertex_data, vertex_count, index_data, index_count,
+                                 cached_lods.data(), static_cast<uint32_t>(cached_lods.size()));
+            } catch (const std::exception& e) {
+                std::cerr << "Mesh cache not written: " << e.what() << '\n';
+            }
+        }
+    }
+
+    // Of the full mesh, the levels of detail behind it are left out
+    mesh_statistics = analyze_vertex_cache(index_data, lods[0].index_count, vertex_count);
+    build_index_ranges();
+    build_model_meshlets();
+    compute_bounding_sphere();
+    model_quantization = GpuVertexLayout::get_quantization(static_cast<const Vertex*>(vertex_data), vertex_count);
+
+    model_load_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+    std::cout << "Loaded " << vertex_count << " vertices and " << lods[0].index_count << " indices "
+              << (mesh_cache_hit ? "from the mesh cache" : "from " + model_path) << " in "
+              << std::fixed << std::setprecision(2) << model_load_milliseconds << " ms, ACMR "
+              << std::setprecision(3) << mesh_statistics.acmr << ", ATVR " << mesh_statistics.atvr << ", "
+              << lods.size() << (lods.size() == 1 ? " level" : " levels") << " of detail down to "
+              << lods.back().index_count / 3 << " triangles, "
+              << (index_type == VK_INDEX_TYPE_UINT16 ? "16" : "32") << "-bit indices in " << index_ranges.size()
+              << (index_ranges.size() == 1 ? " range" : " ranges") << ", " << meshlet_data.meshlets.size() << " meshlets of "
+              << std::setprecision(1) << static_cast<double>(index_count) / 3 / std::max<size_t>(meshlet_data.meshlets.size(), 1)
+              << " triangles on average\n\n";
+}
+
+void Application::build_model_lods() {
+    // Only on a mesh cache miss, the cache holds the levels along with the full mesh
+    lods = {{0, index_count, 0, 0, 0, 0, 0.0f}};
+    if (settings.lod_count <= 1) return;
+
+    auto levels = build_lod_chain(static_cast<const Vertex*>(vertex_data), vertex_count, index_data, index_count,
+                                  settings.lod_count - 1);
+    if (levels.empty()) return;
+
+    lod_indices.assign(index_data, index_data + index_count);
+    for (auto& level : levels) {
+        // Collapses keep what is left of the order of the level before, which has lost most of its cache locality
+        if (settings.mesh_optimization) {
+            optimize_vertex_cache(level.indices, vertex_count);
+        }
+
+        lods.push_back({static_cast<uint32_t>(lod_indices.size()), static_cast<uint32_t>(level.indices.size()), 0, 0, 0, 0, level.error});
+        lod_indices.insert(lod_indices.end(), level.indices.begin(), level.indices.end());
+    }
+
+    index_data = lod_indices.data();
+    index_count = static_cast<uint32_t>(lod_indices.size());
+}
+
+void Application::build_index_ranges() {
+    index_ranges.clear();
+    if (!settings.index_16bit) {
+        index_type = VK_INDEX_TYPE_UINT32;
+        for (auto& lod : lods) {
+            lod.first_range = static_cast<uint32_t>(index_ranges.size());
+            lod.range_count = 1;
+            index_ranges.push_back({lod.first_index, lod.index_count, 0});
+        }
+        return;
+    }
+
+    // Every level indexes the same vertices, so either all of them fit 16 bits or all are cut into
+    // ranges, whose vertices are appended behind those of the levels before
+    index_type = VK_INDEX_TYPE_UINT16;
+    narrow_indices.clear();
+    split_vertices.clear();
+    std::vector<uint16_t> lod_narrow_indices;
+    std::vector<Vertex> lod_split_vertices;
+    for (auto& lod : lods) {
+        auto ranges = build_16bit_index_ranges(static_cast<const Vertex*>(vertex_data), vertex_count, index_data + lod.first_index,
+                                               lod.index_count, lod_narrow_indices, lod_split_vertices);
+
+        lod.first_range = static_cast<uint32_t>(index_ranges.size());
+        lod.range_count = static_cast<uint32_t>(ranges.size());
+        for (auto range : ranges) {
+            range.first_index += lod.first_index;
+            range.vertex_offset += static_cast<int32_t>(split_vertices.size());
+            index_ranges.push_back(range);
+        }
+        narrow_indices.insert(narrow_indices.end(), lod_narrow_indices.begin(), lod_narrow_indices.end());
+        split_vertices.insert(split_vertices.end(), lod_split_vertices.begin(), lod_split_vertices.end());
+    }
+    if (!split_vertices.empty()) {
+        vertex_data = split_vertices.data();
+        vertex_count = static_cast<uint32_t>(split_vertices.size());
+    }
+}
+
+void Application::build_model_meshlets() {
+    // Meshlets refer to the index buffer as it is uploaded, relative to the vertex offset of their range
+    std::vector<uint32_t> widened_indices;
+    const uint32_t* range_indices = index_data;
+    if (index_type == VK_INDEX_TYPE_UINT16) {
+        widened_indices.assign(narrow_indices.begin(), narrow_indices.end());
+        range_indices = widened_indices.data();
+    }
+
+    meshlet_data = build_meshlets(static_cast<const Vertex*>(vertex_data), vertex_count, range_indices, index_ranges);
+
+    // They come out in the order of the ranges, so every level of detail owns a consecutive run
+    max_lod_meshlet_count = 0;
+    uint32_t meshlet = 0;
+    for (auto& lod : lods) {
+        lod.first_meshlet = meshlet;
+        while (meshlet < meshlet_data.meshlets.size() && meshlet_data.meshlets[meshlet].first_index < lod.first_index + lod.index_count) {
+            ++meshlet;
+        }
+        lod.meshlet_count = meshlet - lod.first_meshlet;
+        max_lod_meshlet_count = std::max(max_lod_meshlet_count, lod.meshlet_count);
+    }
+}
+
+uint32_t Application::get_mesh_cache_flags() const {
+    uint32_t flags = 0;
+    if (settings.mesh_optimization) {
+        flags |= mesh_cache_optimized;
+        if (settings.overdraw_sort) flags |= mesh_cache_overdraw_sorted;
+    }
+    flags |= settings.lod_count << mesh_cache_lod_count_shift;
+    return flags;
+}
+
+void Application::compute_bounding_sphere() {
+    // Centered on the bounding box, not minimal but cheap and good enough for culling
+    auto model_vertices = static_cast<const Vertex*>(vertex_data);
+    glm::vec3 min_corner(std::numeric_limits<float>::max());
+    glm::vec3 max_corner(std::numeric_limits<float>::lowest());
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        min_corner = glm::min(min_corner, model_vertices[i].pos);
+        max_corner = glm::max(max_corner, model_vertices[i].pos);
+    }
+
+    glm::vec3 center = (min_corner + max_corner) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        radius = std::max(radius, glm::distance(center, model_vertices[i].pos));
+    }
+
+    bounding_sphere = {center.x, center.y, center.z, radius};
+}
+
+void Application::parse_model(const MappedFile& model_file) {
+    MappedFileBuffer model_buffer(model_file);
+    std::istream model_stream(&model_buffer);
+
+    // Materials are not used, without a material reader the mtllib statement is skipped
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string warning, error;
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, model_path.c_str())) {
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, &model_stream)) {
         throw std::runtime_error(warning + error);
     }
 
-    std::unordered_map<Vertex, uint32_t> unique_vertices{};
+    size_t corner_count = 0;
+    for (const auto& shape : shapes) {
+        corner_count += shape.mesh.indices.size();
+    }
 
+    std::vector<Vertex> corners;
+    corners.reserve(corner_count);
     for (const auto& shape : shapes) {
         for (const auto& index : shape.mesh.indices) {
             Vertex vertex{};
@@ -157,14 +554,22 @@ void Application::load_model() {
 
             vertex.color = {1.0f, 1.0f, 1.0f};
 
-            if (unique_vertices.find(vertex) == unique_vertices.end()) {
-                unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
-
-            indices.push_back(unique_vertices[vertex]);
+            corners.push_back(vertex);
         }
     }
+
+    deduplicate_vertices(corners, vertices, indices);
+    if (!settings.mesh_optimization) return;
+
+    auto optimization_start = std::chrono::steady_clock::now();
+    auto statistics = analyze_vertex_cache(indices.data(), indices.size(), static_cast<uint32_t>(vertices.size()));
+    optimize_mesh(vertices, indices, settings.overdraw_sort);
+    auto optimized_statistics = analyze_vertex_cache(indices.data(), indices.size(), static_cast<uint32_t>(vertices.size()));
+
+    double optimization_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimization_start).count();
+    std::cout << "Optimized the mesh in " << std::fixed << std::setprecision(2) << optimization_milliseconds << " ms, ACMR "
+              << std::setprecision(3) << statistics.acmr << " -> " << optimized_statistics.acmr
+              << ", ATVR " << statistics.atvr << " -> " << optimized_statistics.atvr << '\n';
 }
 
 void Application::init_vulkan() {
@@ -173,25 +578,57 @@ void Application::init_vulkan() {
     create_surface();
     select_physical_device();
     create_logical_device();
-    create_swap_chain();
+    allocator.init(physical_device, device);
+    create_timeline_semaphores();
+    if (settings.headless) {
+        create_offscreen_targets();
+    } else {
+        create_swap_chain();
+    }
     create_image_views();
-    create_render_pass();
+    create_render_passes();
     create_descriptor_set_layout();
+    create_cull_descriptor_set_layout();
+    create_pipeline_cache();
+    auto pipeline_start = std::chrono::steady_clock::now();
     create_graphics_pipeline();
+    create_cull_pipeline();
+    pipeline_creation_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipeline_start).count();
     create_command_pool();
+    create_upload_context();
+    begin_uploads();
+    render_target_extent = swap_chain_extent;
     create_color_resource();
     create_depth_resource();
     create_framebuffers();
-    create_vertex_buffer();
-    create_texture_image();
-    create_texture_image_view();
+    choose_texture_format();
+    if (settings.async_assets) {
+        create_placeholder_assets();
+        start_asset_streaming();
+    } else {
+        load_texture();
+        create_asset_resources();
+        asset_state = AssetState::ready;
+        requested_pipeline_key.mesh_shading = use_mesh_shading;
+    }
     create_texture_sampler();
-    create_index_buffer();
+    create_instance_buffer();
+    create_draw_push_constants();
+    create_cull_buffers();
+    submit_uploads();
     create_uniform_buffers();
     create_descriptor_pool();
     create_descriptor_sets();
+    create_cull_descriptor_sets();
+    create_meshlet_descriptor_set();
     create_command_buffers();
+    create_recording_command_pools();
     create_sync_objects();
+    create_timestamp_query_pool();
+    request_pipeline_variants();
+    wait_for_uploads();
+
+    allocator.print_statistics();
 }
 
 void Application::create_instance() {
@@ -202,7 +639,7 @@ void Application::create_instance() {
     app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     app_info.pEngineName = "no-engine";
     app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    app_info.apiVersion = VK_API_VERSION_1_0;
+    app_info.apiVersion = VK_API_VERSION_1_2;
 
     // Instance Create Info
     VkInstanceCreateInfo create_info{};
@@ -236,9 +673,13 @@ void Application::create_instance() {
     std::cout << '\n';
 
     // Required extensions
-    uint32_t glfw_extension_count = 0;
-    const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-    std::vector<const char*> required_extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
+    // No surface extensions are needed when rendering offscreen
+    std::vector<const char*> required_extensions;
+    if (!settings.headless) {
+        uint32_t glfw_extension_count = 0;
+        const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+        required_extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+    }
     if (enable_validation_layers) {
         required_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
@@ -312,6 +753,8 @@ void Application::setup_debug_messenger() {
 }
 
 void Application::create_surface() {
+    if (settings.headless) return;
+
     if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create window surface.");
     }
@@ -334,8 +777,15 @@ void Application::select_physical_device() {
     }
 
     physical_device = devices.front();
+    usable_sample_counts = get_usable_sample_counts();
     msaa_samples = get_max_usable_sample_count();
-    // msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+    if (settings.msaa_samples != 0) {
+        auto it = std::find(usable_sample_counts.begin(), usable_sample_counts.end(), settings.msaa_samples);
+        if (it == usable_sample_counts.end()) {
+            throw std::runtime_error("Failed to find support for " + std::to_string(settings.msaa_samples) + "x MSAA.");
+        }
+        msaa_samples = *it;
+    }
 }
 
 QueueFamilyIndices Application::find_queue_families(VkPhysicalDevice _device) {
@@ -346,19 +796,35 @@ QueueFamilyIndices Application::find_queue_families(VkPhysicalDevice _device) {
     std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
     vkGetPhysicalDeviceQueueFamilyProperties(_device, &queue_family_count, queue_families.data());
 
-    int i = 0;
+    uint32_t i = 0;
+    bool graphics_and_present_found = false;
     for (const auto& queue_family : queue_families) {
-        if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) { 
-            queue_family_indices.graphics_family = i;
+        if (!graphics_and_present_found) {
+            if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) { 
+                queue_family_indices.graphics_family = i;
+            }
+
+            if (!settings.headless) {
+                VkBool32 present_support = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(_device, i, surface, &present_support);
+                if (present_support) {
+                    queue_family_indices.present_family = i;
+                }
+            }
+
+            graphics_and_present_found = settings.headless ? queue_family_indices.graphics_family.has_value()
+                                                           : queue_family_indices.is_complete();
         }
 
-        VkBool32 present_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(_device, i, surface, &present_support);
-        if (present_support) {
-            queue_family_indices.present_family = i;
+        // Prefer a transfer-only family over one that also does compute
+        auto& transfer_family = queue_family_indices.transfer_family;
+        bool is_transfer_family = (queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        bool is_transfer_only = is_transfer_family && !(queue_family.queueFlags & VK_QUEUE_COMPUTE_BIT);
+        bool found_transfer_only = transfer_family.has_value() && !(queue_families[transfer_family.value()].queueFlags & VK_QUEUE_COMPUTE_BIT);
+        if ((is_transfer_family && !transfer_family.has_value()) || (is_transfer_only && !found_transfer_only)) {
+            transfer_family = i;
         }
 
-        if (queue_family_indices.is_complete()) break;
         ++i;
     }
 
@@ -373,8 +839,13 @@ void Application::create_logical_device() {
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
     std::set<uint32_t> unique_queue_families = {
         queue_family_indices.graphics_family.value(),
-        queue_family_indices.present_family.value(),
     };
+    if (!settings.headless) {
+        unique_queue_families.insert(queue_family_indices.present_family.value());
+    }
+    if (queue_family_indices.transfer_family.has_value()) {
+        unique_queue_families.insert(queue_family_indices.transfer_family.value());
+    }
 
     float queue_priority = 1.0f;
     for (auto queue_family : unique_queue_families) {
@@ -392,6 +863,12 @@ void Application::create_logical_device() {
     device_features.samplerAnisotropy = VK_TRUE;
     device_features.sampleRateShading = VK_TRUE;
 
+    // Needed for the wireframe variants, which are skipped where it is missing
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+    fill_mode_non_solid = supported_features.fillModeNonSolid;
+    device_features.fillModeNonSolid = supported_features.fillModeNonSolid;
+
     // Device create info
     VkDeviceCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -400,15 +877,61 @@ void Application::create_logical_device() {
 
     create_info.pEnabledFeatures = &device_features;
 
+    VkPhysicalDeviceVulkan12Features vulkan12_features{};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12_features.timelineSemaphore = VK_TRUE;
+    create_info.pNext = &vulkan12_features;
+
+    // Cluster culling draws a count of commands written by the culling pass, each picking its
+    // instance with firstInstance. Without these instances are culled as a whole
+    VkPhysicalDeviceVulkan12Features supported_vulkan12_features{};
+    supported_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supported_features2{};
+    supported_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features2.pNext = &supported_vulkan12_features;
+    vkGetPhysicalDeviceFeatures2(physical_device, &supported_features2);
+    use_cluster_culling = settings.gpu_culling && settings.cluster_culling && supported_vulkan12_features.drawIndirectCount &&
+                          supported_features.multiDrawIndirect && supported_features.drawIndirectFirstInstance;
+    if (use_cluster_culling) {
+        vulkan12_features.drawIndirectCount = VK_TRUE;
+        device_features.multiDrawIndirect = VK_TRUE;
+        device_features.drawIndirectFirstInstance = VK_TRUE;
+    }
+
     // Device extensions
-    std::cout << "Required device extensions(" << required_device_extensions.size() << "):\n";
-    for (const auto& extension : required_device_extensions) {
+    auto device_extensions = get_required_device_extensions();
+
+    // Optional, the render pass path is used where it is missing
+    use_dynamic_rendering = settings.dynamic_rendering && supports_dynamic_rendering(physical_device);
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features{};
+    dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    dynamic_rendering_features.dynamicRendering = VK_TRUE;
+    if (use_dynamic_rendering) {
+        device_extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        vulkan12_features.pNext = &dynamic_rendering_features;
+    }
+
+    // Optional as well, the model is drawn with the vertex pipeline where it is missing
+    use_mesh_shading = settings.mesh_shading && supports_mesh_shading(physical_device);
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{};
+    mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    mesh_shader_features.taskShader = VK_TRUE;
+    mesh_shader_features.meshShader = VK_TRUE;
+    if (use_mesh_shading) {
+        device_extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        mesh_shader_features.pNext = vulkan12_features.pNext;
+        vulkan12_features.pNext = &mesh_shader_features;
+        push_constant_stages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+
+    std::cout << "Required device extensions(" << device_extensions.size() << "):\n";
+    for (const auto& extension : device_extensions) {
         std::cout << "\t" << extension << '\n';
     }
     std::cout << '\n';
     
-    create_info.enabledExtensionCount = static_cast<uint32_t>(required_device_extensions.size());
-    create_info.ppEnabledExtensionNames = required_device_extensions.data();
+    create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
+    create_info.ppEnabledExtensionNames = device_extensions.data();
 
     // Device layers
     // Not necessary
@@ -424,15 +947,50 @@ void Application::create_logical_device() {
         throw std::runtime_error("Failed to create logical device.");
     }
 
+    if (use_dynamic_rendering) {
+        cmd_begin_rendering = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        cmd_end_rendering = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+        if (cmd_begin_rendering == nullptr || cmd_end_rendering == nullptr) {
+            throw std::runtime_error("Failed to load VK_KHR_dynamic_rendering functions.");
+        }
+    }
+    std::cout << "Rendering with " << (use_dynamic_rendering ? "dynamic rendering" : "render pass objects") << "\n\n";
+
+    if (use_mesh_shading) {
+        cmd_draw_mesh_tasks = (PFN_vkCmdDrawMeshTasksEXT) vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT");
+        if (cmd_draw_mesh_tasks == nullptr) {
+            throw std::runtime_error("Failed to load VK_EXT_mesh_shader functions.");
+        }
+
+        mesh_shader_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &mesh_shader_properties;
+        vkGetPhysicalDeviceProperties2(physical_device, &properties);
+    }
+
     // Queue handle
     vkGetDeviceQueue(device, queue_family_indices.graphics_family.value(), 0, &graphics_queue);
-    vkGetDeviceQueue(device, queue_family_indices.present_family.value(), 0, &present_queue);
+    if (!settings.headless) {
+        vkGetDeviceQueue(device, queue_family_indices.present_family.value(), 0, &present_queue);
+    }
+
+    // Without a dedicated transfer family uploads go through the graphics queue
+    graphics_queue_family = queue_family_indices.graphics_family.value();
+    transfer_queue_family = queue_family_indices.transfer_family.value_or(graphics_queue_family);
+    vkGetDeviceQueue(device, transfer_queue_family, 0, &transfer_queue);
 }
 
-void Application::create_swap_chain() {
+std::vector<const char*> Application::get_required_device_extensions() {
+    // Swapchain is the only required extension and it is not used offscreen
+    if (settings.headless) return {};
+    return required_device_extensions;
+}
+
+void Application::create_swap_chain(VkSwapchainKHR old_swap_chain) {
     auto swap_chain_support = query_swap_chain_support(physical_device);
     auto surface_format = choose_swap_surface_format(swap_chain_support.formats);
-    auto present_mode = choose_swap_present_mode(swap_chain_support.present_modes);
+    present_mode = choose_swap_present_mode(swap_chain_support.present_modes);
     auto extent = choose_swap_extent(swap_chain_support.capabilities);
 
     uint32_t image_count = swap_chain_support.capabilities.minImageCount + 1;
@@ -473,7 +1031,8 @@ void Application::create_swap_chain() {
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    // Lets the driver hand over resources, and the old swapchain stays presentable until it is destroyed
+    create_info.oldSwapchain = old_swap_chain;
 
     if (vkCreateSwapchainKHR(device, &create_info, nullptr, &swap_chain) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create swap chain.");
@@ -490,40 +1049,122 @@ void Application::create_swap_chain() {
 void Application::recreate_swap_chain() {
     int width = 0, height = 0;
     glfwGetFramebufferSize(window, &width, &height);
-    while (window == 0 || height == 0) {
+    while (width == 0 || height == 0) {
         glfwGetFramebufferSize(window, &width, &height);
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(device);
-
-    cleanup_swap_chain();
+    // Everything submitted so far may still reference the old resources
+    RetiredRenderTargets retired;
+    retired.submission = submission_count;
+    retired.swap_chain = swap_chain;
+    retired.image_views = std::exchange(swap_chain_image_views, {});
+    retired.framebuffers = std::exchange(swap_chain_framebuffers, {});
 
-    create_swap_chain();
+    create_swap_chain(retired.swap_chain);
     create_image_views();
-    create_color_resource();
-    create_depth_resource();
+
+    // Shrinking keeps rendering into the top left corner of the larger attachments
+    if (swap_chain_extent.width > render_target_extent.width || swap_chain_extent.height > render_target_extent.height) {
+        retire_attachments(retired);
+        render_target_extent.width = std::max(render_target_extent.width, swap_chain_extent.width);
+        render_target_extent.height = std::max(render_target_extent.height, swap_chain_extent.height);
+        create_color_resource();
+        create_depth_resource();
+        ++attachment_reallocations;
+    }
     create_framebuffers();
+
+    retired_render_targets.push_back(std::move(retired));
+}
+
+void Application::retire_attachments(RetiredRenderTargets& retired) {
+    retired.color_image = color_image;
+    retired.color_image_view = color_image_view;
+    retired.color_image_allocation = color_image_allocation;
+    retired.depth_image = depth_image;
+    retired.depth_image_view = depth_image_view;
+    retired.depth_image_allocation = depth_image_allocation;
+}
+
+void Application::destroy_retired_render_targets(uint64_t completed_submission) {
+    while (!retired_render_targets.empty() && retired_render_targets.front().submission <= completed_submission) {
+        auto& retired = retired_render_targets.front();
+
+        for (auto framebuffer : retired.framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        for (auto image_view : retired.image_views) {
+            vkDestroyImageView(device, image_view, nullptr);
+        }
+        if (retired.swap_chain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(device, retired.swap_chain, nullptr);
+        }
+
+        if (retired.color_image != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, retired.color_image_view, nullptr);
+            vkDestroyImage(device, retired.color_image, nullptr);
+            allocator.free(retired.color_image_allocation);
+        }
+        if (retired.depth_image != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, retired.depth_image_view, nullptr);
+            vkDestroyImage(device, retired.depth_image, nullptr);
+            allocator.free(retired.depth_image_allocation);
+        }
+
+        retired_render_targets.pop_front();
+    }
 }
 
 void Application::cleanup_swap_chain() {
+    cleanup_render_targets();
+
+    for (auto& image_view : swap_chain_image_views) {
+        vkDestroyImageView(device, image_view, nullptr);
+    }
+
+    if (settings.headless) {
+        for (size_t i = 0; i < swap_chain_images.size(); ++i) {
+            vkDestroyImage(device, swap_chain_images[i], nullptr);
+            allocator.free(offscreen_images_allocations[i]);
+        }
+    } else {
+        vkDestroySwapchainKHR(device, swap_chain, nullptr);
+    }
+}
+
+// Everything that depends on the sample count, recreated when switching to a variant with another one
+void Application::cleanup_render_targets() {
     vkDestroyImageView(device, color_image_view, nullptr);
     vkDestroyImage(device, color_image, nullptr);
-    vkFreeMemory(device, color_image_memory, nullptr);
+    allocator.free(color_image_allocation);
 
     vkDestroyImageView(device, depth_image_view, nullptr);
     vkDestroyImage(device, depth_image, nullptr);
-    vkFreeMemory(device, depth_image_memory, nullptr);
+    allocator.free(depth_image_allocation);
 
     for (auto& frambuffer : swap_chain_framebuffers) {
         vkDestroyFramebuffer(device, frambuffer, nullptr);
     }
+}
 
-    for (auto& image_view : swap_chain_image_views) {
-        vkDestroyImageView(device, image_view, nullptr);
-    }
+void Application::create_offscreen_targets() {
+    swap_chain_image_format = find_supported_format(
+        {VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB},
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+    );
+    swap_chain_extent = {settings.width, settings.height};
 
-    vkDestroySwapchainKHR(device, swap_chain, nullptr);
+    // One target per frame in flight, so frame i always renders into image i
+    swap_chain_images.resize(settings.frames_in_flight);
+    offscreen_images_allocations.resize(settings.frames_in_flight);
+
+    for (size_t i = 0; i < settings.frames_in_flight; ++i) {
+        create_image(swap_chain_extent.width, swap_chain_extent.height, 1, VK_SAMPLE_COUNT_1_BIT, swap_chain_image_format,
+                     VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swap_chain_images[i], offscreen_images_allocations[i]);
+    }
 }
 
 void Application::create_image_views() {
@@ -534,10 +1175,32 @@ void Application::create_image_views() {
     }
 }
 
-void Application::create_render_pass() {
+void Application::create_render_passes() {
+    if (use_dynamic_rendering) {
+        render_pass = VK_NULL_HANDLE;
+        return;
+    }
+
+    for (auto samples : usable_sample_counts) {
+        render_passes.push_back(create_render_pass(samples));
+    }
+    render_pass = get_render_pass(msaa_samples);
+}
+
+VkRenderPass Application::get_render_pass(VkSampleCountFlagBits samples) {
+    if (use_dynamic_rendering) return VK_NULL_HANDLE;
+
+    auto it = std::find(usable_sample_counts.begin(), usable_sample_counts.end(), samples);
+    if (it == usable_sample_counts.end()) {
+        throw std::runtime_error("Failed to find render pass for " + std::to_string(samples) + "x MSAA.");
+    }
+    return render_passes[it - usable_sample_counts.begin()];
+}
+
+VkRenderPass Application::create_render_pass(VkSampleCountFlagBits samples) {
     VkAttachmentDescription color_attachment{};
     color_attachment.format = swap_chain_image_format;
-    color_attachment.samples = msaa_samples;
+    color_attachment.samples = samples;
     color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -547,7 +1210,7 @@ void Application::create_render_pass() {
 
     VkAttachmentDescription depth_attachment{};
     depth_attachment.format = find_depth_format();
-    depth_attachment.samples = msaa_samples;
+    depth_attachment.samples = samples;
     depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -563,7 +1226,7 @@ void Application::create_render_pass() {
     color_attachment_resolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment_resolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment_resolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment_resolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color_attachment_resolve.finalLayout = settings.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference color_attachment_reference{};
     color_attachment_reference.attachment = 0;
@@ -602,9 +1265,73 @@ void Application::create_render_pass() {
     render_pass_create_info.dependencyCount = 1;
     render_pass_create_info.pDependencies = &subpass_dependency;
 
-    if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &render_pass) != VK_SUCCESS) {
+    VkRenderPass _render_pass;
+    if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &_render_pass) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create render pass.");
     }
+    return _render_pass;
+}
+
+void Application::create_pipeline_cache() {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    // Stays mapped until the cache has been created, the driver copies what it needs
+    MappedFile cache_file;
+    if (settings.pipeline_cache && std::filesystem::exists(pipeline_cache_path)) {
+        try {
+            cache_file = MappedFile(pipeline_cache_path);
+        } catch (const std::exception& e) {
+            std::cerr << "Pipeline cache not loaded: " << e.what() << '\n';
+        }
+    }
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (cache_file.is_open()) {
+        if (is_pipeline_cache_compatible(cache_file.get_data(), cache_file.get_size(), properties)) {
+            create_info.initialDataSize = cache_file.get_size();
+            create_info.pInitialData = cache_file.get_data();
+        } else {
+            std::cout << "Pipeline cache was created by another device or driver, ignoring it\n";
+        }
+    }
+
+    if (vkCreatePipelineCache(device, &create_info, nullptr, &pipeline_cache) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline cache.");
+    }
+    pipeline_cache_warm = (create_info.initialDataSize != 0);
+}
+
+void Application::save_pipeline_cache() {
+    if (!settings.pipeline_cache) return;
+
+    size_t data_size = 0;
+    if (vkGetPipelineCacheData(device, pipeline_cache, &data_size, nullptr) != VK_SUCCESS || data_size == 0) {
+        return;
+    }
+
+    std::vector<char> data(data_size);
+    if (vkGetPipelineCacheData(device, pipeline_cache, &data_size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    // Written next to the destination and renamed over it, a crash mid-write never leaves a truncated cache
+    std::string temporary_path = pipeline_cache_path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data_size));
+        if (!file) {
+            std::cerr << "Failed to write: " << temporary_path << '\n';
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, pipeline_cache_path, error);
+    if (error) {
+        std::cerr << "Failed to write: " << pipeline_cache_path << '\n';
+    }
 }
 
 void Application::create_descriptor_set_layout() {
@@ -612,7 +1339,8 @@ void Application::create_descriptor_set_layout() {
     ubo_layout_binding.binding = 0;
     ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     ubo_layout_binding.descriptorCount = 1;
-    ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    // Read by the same geometry stages as the push constants, the task and mesh shaders included
+    ubo_layout_binding.stageFlags = push_constant_stages;
 
     VkDescriptorSetLayoutBinding sampler_layout_binding{};
     sampler_layout_binding.binding = 1;
@@ -634,15 +1362,76 @@ void Application::create_descriptor_set_layout() {
     if (vkCreateDescriptorSetLayout(device, &create_info, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor set layout.");
     }
+
+    if (!use_mesh_shading) return;
+
+    // Instances, meshlets, meshlet vertices, meshlet triangles, the vertex buffer and the levels of detail
+    std::array<VkDescriptorSetLayoutBinding, 6> meshlet_bindings{};
+    for (uint32_t i = 0; i < meshlet_bindings.size(); ++i) {
+        meshlet_bindings[i].binding = i;
+        meshlet_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        meshlet_bindings[i].descriptorCount = 1;
+        meshlet_bindings[i].stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+
+    create_info.bindingCount = static_cast<uint32_t>(meshlet_bindings.size());
+    create_info.pBindings = meshlet_bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &create_info, nullptr, &meshlet_descriptor_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create meshlet descriptor set layout.");
+    }
 }
 
 void Application::create_graphics_pipeline() {
-    auto vert_shader_code = read_file("shaders/shader_vert.spv");
-    auto frag_shader_code = read_file("shaders/shader_frag.spv");
+    // Kept for the lifetime of the pipeline library, variants are compiled from them in the background
+    vert_shader_module = create_shader_module("shaders/shader_vert.spv");
+    frag_shader_module = create_shader_module("shaders/shader_frag.spv");
+    if (use_mesh_shading) {
+        task_shader_module = create_shader_module("shaders/meshlet_task.spv");
+        mesh_shader_module = create_shader_module("shaders/meshlet_mesh.spv");
+    }
+
+    // Vertex pipelines never touch the meshlet set, so both kinds of variants share the layout
+    std::vector<VkDescriptorSetLayout> set_layouts = {descriptor_set_layout};
+    if (use_mesh_shading) {
+        set_layouts.push_back(meshlet_descriptor_set_layout);
+    }
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+    pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+    pipeline_layout_create_info.pSetLayouts = set_layouts.data();
+
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = push_constant_stages;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(DrawPushConstants) + sizeof(MeshPushConstants);
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+    if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout.");
+    }
+
+    pipeline_key.samples = msaa_samples;
+    pipeline_key.polygon_mode = VK_POLYGON_MODE_FILL;
+    pipeline_key.depth_only = settings.depth_only;
+    pipeline_key.blended = settings.blended;
+    if (settings.wireframe) {
+        if (fill_mode_non_solid) {
+            pipeline_key.polygon_mode = VK_POLYGON_MODE_LINE;
+        } else {
+            std::cerr << "Wireframe rendering is not supported by this device, drawing filled polygons\n";
+        }
+    }
+    requested_pipeline_key = pipeline_key;
 
-    auto vert_shader_module = create_shader_module(vert_shader_code);
-    auto frag_shader_module = create_shader_module(frag_shader_code);
+    // The first frame cannot fall back to anything, so its variant is compiled right away
+    pipeline_library.init(device, thread_pool, [this] (const PipelineKey& key) { return compile_graphics_pipeline(key); });
+    graphics_pipeline = compile_graphics_pipeline(pipeline_key);
+    pipeline_library.insert(pipeline_key, graphics_pipeline);
+}
 
+VkPipeline Application::compile_graphics_pipeline(const PipelineKey& key) {
     VkPipelineShaderStageCreateInfo vert_shader_stage_create_info{};
     vert_shader_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vert_shader_stage_create_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -655,17 +1444,54 @@ void Application::create_graphics_pipeline() {
     frag_shader_stage_create_info.module = frag_shader_module;
     frag_shader_stage_create_info.pName = "main";
 
-    VkPipelineShaderStageCreateInfo shader_stages[] = {
-        vert_shader_stage_create_info,
-        frag_shader_stage_create_info,
-    };
+    // The task shader culls meshlets unless culling is disabled altogether
+    VkBool32 cluster_culling = settings.gpu_culling && settings.cluster_culling;
+    VkSpecializationMapEntry specialization_entry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo task_specialization_info{};
+    task_specialization_info.mapEntryCount = 1;
+    task_specialization_info.pMapEntries = &specialization_entry;
+    task_specialization_info.dataSize = sizeof(VkBool32);
+    task_specialization_info.pData = &cluster_culling;
+
+    VkPipelineShaderStageCreateInfo task_shader_stage_create_info{};
+    task_shader_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    task_shader_stage_create_info.stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+    task_shader_stage_create_info.module = task_shader_module;
+    task_shader_stage_create_info.pName = "main";
+    task_shader_stage_create_info.pSpecializationInfo = &task_specialization_info;
+
+    VkPipelineShaderStageCreateInfo mesh_shader_stage_create_info{};
+    mesh_shader_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    mesh_shader_stage_create_info.stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+    mesh_shader_stage_create_info.module = mesh_shader_module;
+    mesh_shader_stage_create_info.pName = "main";
+
+    std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
+    if (key.mesh_shading) {
+        shader_stages.push_back(task_shader_stage_create_info);
+        shader_stages.push_back(mesh_shader_stage_create_info);
+    } else {
+        shader_stages.push_back(vert_shader_stage_create_info);
+    }
+    if (!key.depth_only) {
+        shader_stages.push_back(frag_shader_stage_create_info);
+    }
 
     VkPipelineVertexInputStateCreateInfo vertex_input_create_info{};
     vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    auto binding_descriptions = Vertex::get_binding_description();
-    auto attribute_descriptions = Vertex::get_attribute_description();
-    vertex_input_create_info.vertexBindingDescriptionCount = 1;
-    vertex_input_create_info.pVertexBindingDescriptions = &binding_descriptions;
+    std::array<VkVertexInputBindingDescription, 2> binding_descriptions = {
+        GpuVertexLayout::get_binding_description(),
+        InstanceData::get_binding_description(),
+    };
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+    for (const auto& attribute_description : GpuVertexLayout::get_attribute_description()) {
+        attribute_descriptions.push_back(attribute_description);
+    }
+    for (const auto& attribute_description : InstanceData::get_attribute_description()) {
+        attribute_descriptions.push_back(attribute_description);
+    }
+    vertex_input_create_info.vertexBindingDescriptionCount = static_cast<uint32_t>(binding_descriptions.size());
+    vertex_input_create_info.pVertexBindingDescriptions = binding_descriptions.data();
     vertex_input_create_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
     vertex_input_create_info.pVertexAttributeDescriptions = attribute_descriptions.data();
 
@@ -683,7 +1509,7 @@ void Application::create_graphics_pipeline() {
     rasterizer_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizer_create_info.depthClampEnable = VK_FALSE;
     rasterizer_create_info.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer_create_info.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer_create_info.polygonMode = key.polygon_mode;
     rasterizer_create_info.lineWidth = 1.0f;
     rasterizer_create_info.cullMode = VK_CULL_MODE_BACK_BIT;
     rasterizer_create_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
@@ -693,7 +1519,7 @@ void Application::create_graphics_pipeline() {
     multisample_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisample_create_info.sampleShadingEnable = VK_TRUE;
     multisample_create_info.minSampleShading = 0.2f;
-    multisample_create_info.rasterizationSamples = msaa_samples;
+    multisample_create_info.rasterizationSamples = key.samples;
 
     VkPipelineColorBlendAttachmentState color_blend_attachment{};
     color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
@@ -701,6 +1527,19 @@ void Application::create_graphics_pipeline() {
                                             VK_COLOR_COMPONENT_B_BIT |
                                             VK_COLOR_COMPONENT_A_BIT;
     color_blend_attachment.blendEnable = VK_FALSE;
+    if (key.blended) {
+        color_blend_attachment.blendEnable = VK_TRUE;
+        color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+        color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+    // Without a fragment shader only depth is written, the color attachment keeps its clear value
+    if (key.depth_only) {
+        color_blend_attachment.colorWriteMask = 0;
+    }
     
     VkPipelineColorBlendStateCreateInfo color_blend_state_create_info{};
     color_blend_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -720,7 +1559,7 @@ void Application::create_graphics_pipeline() {
     VkPipelineDepthStencilStateCreateInfo depth_stencil_state_create_info{};
     depth_stencil_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
     depth_stencil_state_create_info.depthTestEnable = VK_TRUE;
-    depth_stencil_state_create_info.depthWriteEnable = VK_TRUE;
+    depth_stencil_state_create_info.depthWriteEnable = key.blended ? VK_FALSE : VK_TRUE;
     depth_stencil_state_create_info.depthCompareOp = VK_COMPARE_OP_LESS;
     depth_stencil_state_create_info.depthBoundsTestEnable = VK_FALSE;
     depth_stencil_state_create_info.minDepthBounds = 0.0f;
@@ -729,20 +1568,12 @@ void Application::create_graphics_pipeline() {
     depth_stencil_state_create_info.front = {};
     depth_stencil_state_create_info.back = {};
 
-    VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
-    pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipeline_layout_create_info.setLayoutCount = 1;
-    pipeline_layout_create_info.pSetLayouts = &descriptor_set_layout;
-    if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create pipeline layout.");
-    }
-
     VkGraphicsPipelineCreateInfo pipeline_create_info{};
     pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_create_info.stageCount = 2;
-    pipeline_create_info.pStages = shader_stages;
-    pipeline_create_info.pVertexInputState = &vertex_input_create_info;
-    pipeline_create_info.pInputAssemblyState = &input_assembly_create_info;
+    pipeline_create_info.stageCount = static_cast<uint32_t>(shader_stages.size());
+    pipeline_create_info.pStages = shader_stages.data();
+    pipeline_create_info.pVertexInputState = key.mesh_shading ? nullptr : &vertex_input_create_info;
+    pipeline_create_info.pInputAssemblyState = key.mesh_shading ? nullptr : &input_assembly_create_info;
     pipeline_create_info.pViewportState = &viewport_state_create_info;
     pipeline_create_info.pRasterizationState = &rasterizer_create_info;
     pipeline_create_info.pMultisampleState = &multisample_create_info;
@@ -753,18 +1584,89 @@ void Application::create_graphics_pipeline() {
 
     pipeline_create_info.layout = pipeline_layout;
 
-    pipeline_create_info.renderPass = render_pass;
+    pipeline_create_info.renderPass = get_render_pass(key.samples);
     pipeline_create_info.subpass = 0;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &graphics_pipeline) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create graphics pipeline.");
+    VkFormat color_format = swap_chain_image_format;
+    VkPipelineRenderingCreateInfoKHR rendering_create_info{};
+    rendering_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    rendering_create_info.colorAttachmentCount = 1;
+    rendering_create_info.pColorAttachmentFormats = &color_format;
+    rendering_create_info.depthAttachmentFormat = find_depth_format();
+    if (use_dynamic_rendering) {
+        pipeline_create_info.pNext = &rendering_create_info;
     }
 
-    vkDestroyShaderModule(device, frag_shader_module, nullptr);
-    vkDestroyShaderModule(device, vert_shader_module, nullptr);
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create graphics pipeline.");
+    }
+    return pipeline;
+}
+
+void Application::request_pipeline_variants() {
+    std::vector<VkPolygonMode> polygon_modes = {VK_POLYGON_MODE_FILL};
+    if (fill_mode_non_solid) {
+        polygon_modes.push_back(VK_POLYGON_MODE_LINE);
+    }
+
+    // Compiled ahead of time, so switching later finds them ready. With mesh shading the vertex
+    // pipeline only draws the placeholder, which starts with the variant compiled at startup, and
+    // any other one it is switched to is compiled on demand
+    for (auto samples : usable_sample_counts) {
+        for (auto polygon_mode : polygon_modes) {
+            for (uint32_t flags = 0; flags < 3; ++flags) {
+                PipelineKey key;
+                key.samples = samples;
+                key.polygon_mode = polygon_mode;
+                key.depth_only = (flags == 1);
+                key.blended = (flags == 2);
+                key.mesh_shading = use_mesh_shading;
+                pipeline_library.request(key);
+            }
+        }
+    }
+}
+
+void Application::update_pipeline_variant() {
+    if (requested_pipeline_key == pipeline_key) return;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    auto state = pipeline_library.find(requested_pipeline_key, pipeline);
+    if (state == PipelineState::missing) {
+        pipeline_library.request(requested_pipeline_key);
+        return;
+    } else if (state == PipelineState::failed) {
+        std::cerr << "Pipeline variant " << describe_pipeline_key(requested_pipeline_key) << " is unavailable\n";
+        requested_pipeline_key = pipeline_key;
+        return;
+    } else if (state == PipelineState::compiling) {
+        return;
+    }
+
+    // Attachments share the sample count of the pipeline, so they are recreated against the matching render pass
+    if (requested_pipeline_key.samples != pipeline_key.samples) {
+        RetiredRenderTargets retired;
+        retired.submission = submission_count;
+        retired.framebuffers = std::exchange(swap_chain_framebuffers, {});
+        retire_attachments(retired);
+        retired_render_targets.push_back(std::move(retired));
+
+        msaa_samples = requested_pipeline_key.samples;
+        render_pass = get_render_pass(msaa_samples);
+        create_color_resource();
+        create_depth_resource();
+        create_framebuffers();
+    }
+
+    pipeline_key = requested_pipeline_key;
+    graphics_pipeline = pipeline;
+    std::cout << "Pipeline variant: " << describe_pipeline_key(pipeline_key) << std::endl;
 }
 
 void Application::create_framebuffers() {
+    if (use_dynamic_rendering) return;
+
     swap_chain_framebuffers.resize(swap_chain_image_views.size());
 
     for (size_t i = 0; i < swap_chain_image_views.size(); ++i) {
@@ -790,7 +1692,7 @@ void Application::create_framebuffers() {
 }
 
 void Application::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                                VkBuffer& buffer, VkDeviceMemory& buffer_memory) {
+                                VkBuffer& buffer, Allocation& allocation) {
     VkBufferCreateInfo buffer_create_info{};
     buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     buffer_create_info.size = size;
@@ -803,98 +1705,341 @@ void Application::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkM
 
     VkMemoryRequirements memory_requirements;
     vkGetBufferMemoryRequirements(device, buffer, &memory_requirements);
-    
-    VkMemoryAllocateInfo memory_allocate_info{};
-    memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memory_allocate_info.allocationSize = memory_requirements.size;
-    memory_allocate_info.memoryTypeIndex = find_memory_type(memory_requirements.memoryTypeBits, properties);
-    
-    if (vkAllocateMemory(device, &memory_allocate_info, nullptr, &buffer_memory) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate vertex buffer memory.");
+
+    allocation = allocator.allocate(memory_requirements, properties, true);
+    if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to bind buffer memory.");
     }
-    vkBindBufferMemory(device, buffer, buffer_memory, 0);
 }
 
-void Application::copy_buffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) {
-    auto command_buffer = begin_single_time_commands();
-
+void Application::copy_buffer(VkCommandBuffer command_buffer, VkBuffer src_buffer, VkDeviceSize src_offset,
+                              VkBuffer dst_buffer, VkDeviceSize size) {
     VkBufferCopy copy_region{};
+    copy_region.srcOffset = src_offset;
     copy_region.size = size;
     vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
-
-    end_single_time_commands(command_buffer);
 }
 
 void Application::create_vertex_buffer() {
-    VkDeviceSize buffer_size = get_vector_data_size(vertices);
+    VkDeviceSize buffer_size = static_cast<VkDeviceSize>(vertex_count) * GpuVertexLayout::stride;
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    // The mesh shader fetches vertices from it as a storage buffer
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    if (use_mesh_shading) {
+        usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    }
+    create_buffer(buffer_size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer, vertex_buffer_allocation);
 
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 staging_buffer, staging_buffer_memory);
-    
-    {
-        void* data;
-        vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
-            std::memcpy(data, vertices.data(), buffer_size);
-        vkUnmapMemory(device, staging_buffer_memory);
+    upload_vertices(static_cast<const Vertex*>(vertex_data), vertex_count, model_quantization, vertex_buffer);
+}
+
+void Application::create_index_buffer() {
+    bool narrow = (index_type == VK_INDEX_TYPE_UINT16);
+    VkDeviceSize buffer_size = static_cast<VkDeviceSize>(index_count) * (narrow ? sizeof(uint16_t) : sizeof(uint32_t));
+
+    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index_buffer, index_buffer_allocation);
+
+    upload_buffer(narrow ? static_cast<const void*>(narrow_indices.data()) : index_data, buffer_size, index_buffer,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+}
+
+void Application::create_instance_buffer() {
+    // Instances are shrunk to fit a grid covering the footprint of a single model,
+    // each one turned a little further than the previous
+    uint32_t grid_size = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(settings.instance_count))));
+    float cell_size = 2.0f / grid_size;
+
+    std::vector<InstanceData> instances(settings.instance_count);
+    for (uint32_t i = 0; i < settings.instance_count; ++i) {
+        if (grid_size == 1) {
+            instances[i].model = glm::mat4(1.0f);
+            continue;
+        }
+
+        glm::vec3 center = {
+            -1.0f + cell_size * (i % grid_size + 0.5f),
+            -1.0f + cell_size * (i / grid_size + 0.5f),
+            0.0f,
+        };
+        instances[i].model = glm::translate(glm::mat4(1.0f), center);
+        instances[i].model = glm::rotate(instances[i].model, glm::radians(17.0f * i), glm::vec3(0.0f, 0.0f, 1.0f));
+        instances[i].model = glm::scale(instances[i].model, glm::vec3(1.0f / grid_size));
     }
 
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer, vertex_buffer_memory);
+    VkDeviceSize buffer_size = get_vector_data_size(instances);
 
-    copy_buffer(staging_buffer, vertex_buffer, buffer_size);
+    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, instance_buffer, instance_buffer_allocation);
 
-    vkDestroyBuffer(device, staging_buffer, nullptr);
-    vkFreeMemory(device, staging_buffer_memory, nullptr);
+    // Read as a vertex buffer without culling and as a storage buffer by the culling pass
+    upload_buffer(instances.data(), buffer_size, instance_buffer,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
 }
 
-void Application::create_index_buffer() {
-    VkDeviceSize buffer_size = get_vector_data_size(indices);
+void Application::create_indirect_buffer() {
+    // The instance count lives on the GPU, so recording cost does not depend on it. Without
+    // culling nothing picks a level of detail, every instance is drawn with the full mesh
+    std::vector<VkDrawIndexedIndirectCommand> draw_commands(lods[0].range_count);
+    for (size_t i = 0; i < draw_commands.size(); ++i) {
+        draw_commands[i].indexCount = index_ranges[i].index_count;
+        draw_commands[i].instanceCount = settings.instance_count;
+        draw_commands[i].firstIndex = index_ranges[i].first_index;
+        draw_commands[i].vertexOffset = index_ranges[i].vertex_offset;
+        draw_commands[i].firstInstance = 0;
+    }
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    VkDeviceSize buffer_size = get_vector_data_size(draw_commands);
 
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 staging_buffer, staging_buffer_memory);
-    
-    {
-        void* data;
-        vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
-            std::memcpy(data, indices.data(), (size_t) buffer_size);
-        vkUnmapMemory(device, staging_buffer_memory);
+    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirect_buffer, indirect_buffer_allocation);
+
+    upload_buffer(draw_commands.data(), buffer_size, indirect_buffer,
+                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+}
+
+void Application::create_meshlet_buffers() {
+    // A draw of every meshlet of every instance has to fit in the task shader dispatch limits
+    if (use_mesh_shading) {
+        uint32_t task_group_count = (max_lod_meshlet_count + meshlets_per_task_group - 1) / meshlets_per_task_group;
+        const auto& limits = mesh_shader_properties;
+        if (task_group_count > limits.maxTaskWorkGroupCount[0] || settings.instance_count > limits.maxTaskWorkGroupCount[1] ||
+            static_cast<uint64_t>(task_group_count) * settings.instance_count > limits.maxTaskWorkGroupTotalCount) {
+            std::cerr << "Too many meshlets or instances for a mesh shader draw, drawing with the vertex pipeline\n";
+            use_mesh_shading = false;
+        }
     }
+    if (!settings.gpu_culling && !use_mesh_shading) return;
 
-    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index_buffer, index_buffer_memory);
+    VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (use_mesh_shading) {
+        dst_stages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+    }
+
+    VkDeviceSize meshlet_buffer_size = get_vector_data_size(meshlet_data.meshlets);
+    create_buffer(meshlet_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshlet_buffer, meshlet_buffer_allocation);
+    upload_buffer(meshlet_data.meshlets.data(), meshlet_buffer_size, meshlet_buffer, dst_stages, VK_ACCESS_SHADER_READ_BIT);
+
+    // Only the mesh shader reads the vertices and triangles, the culling pass draws from the index buffer
+    if (!use_mesh_shading) return;
+
+    VkDeviceSize vertex_buffer_size = get_vector_data_size(meshlet_data.vertices);
+    create_buffer(vertex_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshlet_vertex_buffer, meshlet_vertex_buffer_allocation);
+    upload_buffer(meshlet_data.vertices.data(), vertex_buffer_size, meshlet_vertex_buffer,
+                  VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT, VK_ACCESS_SHADER_READ_BIT);
+
+    VkDeviceSize triangle_buffer_size = get_vector_data_size(meshlet_data.triangles);
+    create_buffer(triangle_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshlet_triangle_buffer, meshlet_triangle_buffer_allocation);
+    upload_buffer(meshlet_data.triangles.data(), triangle_buffer_size, meshlet_triangle_buffer,
+                  VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void Application::create_lod_buffer() {
+    if (!settings.gpu_culling && !use_mesh_shading) return;
+
+    VkPipelineStageFlags dst_stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (use_mesh_shading) {
+        dst_stages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT;
+    }
+
+    VkDeviceSize buffer_size = get_vector_data_size(lods);
+    create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, lod_buffer, lod_buffer_allocation);
+    upload_buffer(lods.data(), buffer_size, lod_buffer, dst_stages, VK_ACCESS_SHADER_READ_BIT);
+}
 
-    copy_buffer(staging_buffer, index_buffer, buffer_size);
+void Application::create_meshlet_descriptor_set() {
+    if (!use_mesh_shading) return;
 
-    vkDestroyBuffer(device, staging_buffer, nullptr);
-    vkFreeMemory(device, staging_buffer_memory, nullptr);
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &meshlet_descriptor_set_layout;
+
+    if (vkAllocateDescriptorSets(device, &alloc_info, &meshlet_descriptor_set) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate meshlet descriptor set.");
+    }
+
+    if (asset_state == AssetState::ready) {
+        write_meshlet_descriptors();
+    }
+}
+
+void Application::write_meshlet_descriptors() {
+    if (!use_mesh_shading) return;
+
+    // Only bound by mesh shading variants, which are not drawn with before the assets are ready,
+    // and never changes afterwards, so every frame shares it
+    std::array<VkDescriptorBufferInfo, 6> buffer_infos{};
+    buffer_infos[0] = {instance_buffer, 0, VK_WHOLE_SIZE};
+    buffer_infos[1] = {meshlet_buffer, 0, VK_WHOLE_SIZE};
+    buffer_infos[2] = {meshlet_vertex_buffer, 0, VK_WHOLE_SIZE};
+    buffer_infos[3] = {meshlet_triangle_buffer, 0, VK_WHOLE_SIZE};
+    buffer_infos[4] = {vertex_buffer, 0, VK_WHOLE_SIZE};
+    buffer_infos[5] = {lod_buffer, 0, VK_WHOLE_SIZE};
+
+    std::array<VkWriteDescriptorSet, 6> descriptor_writes{};
+    for (uint32_t binding = 0; binding < descriptor_writes.size(); ++binding) {
+        descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_writes[binding].dstSet = meshlet_descriptor_set;
+        descriptor_writes[binding].dstBinding = binding;
+        descriptor_writes[binding].dstArrayElement = 0;
+        descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptor_writes[binding].descriptorCount = 1;
+        descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+    }
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+}
+
+void Application::create_asset_resources() {
+    create_vertex_buffer();
+    create_index_buffer();
+    create_indirect_buffer();
+    create_meshlet_buffers();
+    create_lod_buffer();
+    create_culled_indirect_buffers();
+    create_texture_image();
+    create_texture_image_view();
+}
+
+void Application::create_placeholder_assets() {
+    // A cube in place of the model, one quad per face with the corners counterclockwise seen from outside
+    std::vector<Vertex> cube_vertices;
+    std::vector<uint16_t> cube_indices;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (float side : {-1.0f, 1.0f}) {
+            glm::vec3 normal(0.0f);
+            normal[axis] = side;
+            glm::vec3 u(0.0f);
+            u[(axis + 1) % 3] = 1.0f;
+            glm::vec3 v = glm::cross(normal, u);
+
+            auto first_vertex = static_cast<uint32_t>(cube_vertices.size());
+            for (glm::vec2 corner : {glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f)}) {
+                Vertex vertex{};
+                vertex.pos = 0.5f * (normal + corner.x * u + corner.y * v);
+                vertex.color = glm::vec3(1.0f);
+                vertex.tex_coord = 0.5f * corner + 0.5f;
+                cube_vertices.push_back(vertex);
+            }
+            for (uint32_t index : {0u, 1u, 2u, 2u, 3u, 0u}) {
+                cube_indices.push_back(static_cast<uint16_t>(first_vertex + index));
+            }
+        }
+    }
+    placeholder_index_count = static_cast<uint32_t>(cube_indices.size());
+    auto cube_vertex_count = static_cast<uint32_t>(cube_vertices.size());
+    placeholder_quantization = GpuVertexLayout::get_quantization(cube_vertices.data(), cube_vertex_count);
+
+    VkDeviceSize vertex_buffer_size = static_cast<VkDeviceSize>(cube_vertex_count) * GpuVertexLayout::stride;
+    create_buffer(vertex_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, placeholder_vertex_buffer, placeholder_vertex_buffer_allocation);
+    upload_vertices(cube_vertices.data(), cube_vertex_count, placeholder_quantization, placeholder_vertex_buffer);
+
+    VkDeviceSize index_buffer_size = get_vector_data_size(cube_indices);
+    create_buffer(index_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, placeholder_index_buffer, placeholder_index_buffer_allocation);
+    upload_buffer(cube_indices.data(), index_buffer_size, placeholder_index_buffer,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+    // A single mid grey texel
+    const uint8_t grey_texel[4] = {128, 128, 128, 255};
+    create_image(1, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+                 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, placeholder_texture_image, placeholder_texture_image_allocation);
+    upload_image_levels({{1, 1, grey_texel, sizeof(grey_texel)}}, placeholder_texture_image, VK_FORMAT_R8G8B8A8_SRGB);
+    placeholder_texture_image_view = create_image_view(placeholder_texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void Application::start_asset_streaming() {
+    asset_streaming_start = std::chrono::steady_clock::now();
+
+    // Reads nothing the frame loop writes, and the frame loop reads none of its results before it is done
+    asset_loading = thread_pool.submit([this] () {
+        load_model();
+        load_texture();
+    });
+}
+
+void Application::update_asset_streaming() {
+    if (asset_state == AssetState::loading) {
+        if (asset_loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+
+        // Rethrows whatever went wrong while loading
+        asset_loading.get();
+
+        begin_uploads();
+        create_asset_resources();
+        submit_uploads();
+        write_culled_indirect_descriptors();
+        write_meshlet_descriptors();
+        asset_state = AssetState::uploading;
+    }
+
+    if (asset_state == AssetState::uploading && get_completed_submission() >= upload_submission) {
+        wait_for_uploads();
+        asset_state = AssetState::ready;
+
+        // The placeholder has no meshlets, so the vertex pipeline draws until now
+        requested_pipeline_key.mesh_shading = use_mesh_shading;
+
+        assets_ready_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - asset_streaming_start).count();
+        std::cout << "Streamed assets ready after " << std::fixed << std::setprecision(2) << assets_ready_milliseconds << " ms\n";
+    }
+}
+
+void Application::finish_asset_streaming() {
+    if (asset_state == AssetState::loading) {
+        asset_loading.wait();
+        update_asset_streaming();
+    }
+    wait_for_uploads();
+    update_asset_streaming();
+}
+
+void Application::update_texture_descriptor(size_t frame) {
+    VkDescriptorImageInfo image_info{};
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    image_info.imageView = texture_image_view;
+    image_info.sampler = texture_sampler;
+
+    VkWriteDescriptorSet descriptor_write{};
+    descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptor_write.dstSet = descriptor_sets[frame];
+    descriptor_write.dstBinding = 1;
+    descriptor_write.dstArrayElement = 0;
+    descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptor_write.descriptorCount = 1;
+    descriptor_write.pImageInfo = &image_info;
+
+    vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
+    descriptor_texture_views[frame] = texture_image_view;
 }
 
 void Application::create_uniform_buffers() {
     VkDeviceSize buffer_size = sizeof(UniformBufferObject);
 
-    uniform_buffers.resize(MAX_FRAMES_IN_FLIGHT);
-    uniform_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
-    uniform_buffers_pointers.resize(MAX_FRAMES_IN_FLIGHT);
+    uniform_buffers.resize(settings.frames_in_flight);
+    uniform_buffers_allocations.resize(settings.frames_in_flight);
+    uniform_buffers_pointers.resize(settings.frames_in_flight);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    for (size_t i = 0; i < settings.frames_in_flight; ++i) {
         create_buffer(buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     uniform_buffers[i], uniform_buffers_memory[i]);
-        vkMapMemory(device, uniform_buffers_memory[i], 0, buffer_size, 0, &uniform_buffers_pointers[i]);
+                     uniform_buffers[i], uniform_buffers_allocations[i]);
+        uniform_buffers_pointers[i] = uniform_buffers_allocations[i].mapped;
     }
 }
 
 void Application::create_image(uint32_t width, uint32_t height, uint32_t _mip_levels, VkSampleCountFlagBits nr_samples,
                                VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, 
-                               VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory) {
+                               VkMemoryPropertyFlags properties, VkImage& image, Allocation& allocation) {
     VkImageCreateInfo image_info{};
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_info.imageType = VK_IMAGE_TYPE_2D;
@@ -917,16 +2062,10 @@ void Application::create_image(uint32_t width, uint32_t height, uint32_t _mip_le
     VkMemoryRequirements memory_requirements;
     vkGetImageMemoryRequirements(device, image, &memory_requirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memory_requirements.size;
-    allocInfo.memoryTypeIndex = find_memory_type(memory_requirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &image_memory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
+    allocation = allocator.allocate(memory_requirements, properties, tiling == VK_IMAGE_TILING_LINEAR);
+    if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to bind image memory.");
     }
-
-    vkBindImageMemory(device, image, image_memory, 0);
 }
 
 VkImageView Application::create_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, uint32_t _mip_levels) {
@@ -949,9 +2088,8 @@ VkImageView Application::create_image_view(VkImage image, VkFormat format, VkIma
     return image_view;
 }
 
-void Application::transition_image_layout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t _mip_levels) {
-    auto command_buffer = begin_single_time_commands();
-
+void Application::transition_image_layout(VkCommandBuffer command_buffer, VkImage image, VkFormat format,
+                                          VkImageLayout old_layout, VkImageLayout new_layout, uint32_t _mip_levels) {
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = old_layout;
@@ -1004,18 +2142,15 @@ void Application::transition_image_layout(VkImage image, VkFormat format, VkImag
         0, nullptr,
         1, &barrier
     );
-
-    end_single_time_commands(command_buffer);
 }
 
-void Application::generate_mipmaps(VkImage image, VkFormat image_format, int32_t texture_width, int32_t texture_height, uint32_t _mip_levels) {
+void Application::generate_mipmaps(VkCommandBuffer command_buffer, VkImage image, VkFormat image_format,
+                                   int32_t texture_width, int32_t texture_height, uint32_t _mip_levels) {
     VkFormatProperties format_properties{};
     vkGetPhysicalDeviceFormatProperties(physical_device, image_format, &format_properties);
     if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
         throw std::runtime_error("Texture image format does not support linear blitting.");
     }
-    
-    auto command_buffer = begin_single_time_commands();
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1092,60 +2227,147 @@ void Application::generate_mipmaps(VkImage image, VkFormat image_format, int32_t
                          0, nullptr,
                          0, nullptr,
                          1, &barrier);
+}
+
+void Application::choose_texture_format() {
+    // A quarter of the memory of RGBA8 and no mip blits, but not every device samples BC7
+    bool compressed = settings.texture_compression &&
+                      is_format_supported(VK_FORMAT_BC7_SRGB_BLOCK, VK_IMAGE_TILING_OPTIMAL,
+                                          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
 
-    end_single_time_commands(command_buffer);
+    // Blits need linear filtering support, without it the mips are always built on the CPU
+    bool blittable = is_format_supported(VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+                                         VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                         VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+    texture_format = compressed ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB;
+    texture_mipmaps_on_cpu = compressed || settings.cpu_mipmaps || !blittable;
 }
 
-void Application::create_texture_image() {
+MipLevel Application::decode_texture_file(const MappedFile& texture_file) {
     int texture_width, texture_height, texture_nr_channels;
-    stbi_uc* pixels = stbi_load(texture_path.c_str(), 
-                                &texture_width, &texture_height, &texture_nr_channels, 
-                                STBI_rgb_alpha);
+    stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(texture_file.get_data()),
+                                            static_cast<int>(texture_file.get_size()),
+                                            &texture_width, &texture_height, &texture_nr_channels,
+                                            STBI_rgb_alpha);
 
     if (pixels == nullptr) {
         throw std::runtime_error("Failed to load texture image.");
     }
 
-    mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(texture_width, texture_height)))) + 1;
+    MipLevel level;
+    level.width = static_cast<uint32_t>(texture_width);
+    level.height = static_cast<uint32_t>(texture_height);
+    level.pixels.assign(pixels, pixels + static_cast<size_t>(level.width) * level.height * 4);
+    stbi_image_free(pixels);
+    return level;
+}
 
-    VkDeviceSize image_size = texture_width * texture_height * 4;
+void Application::load_texture() {
+    auto load_start = std::chrono::steady_clock::now();
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    bool compressed = (texture_format == VK_FORMAT_BC7_SRGB_BLOCK);
+    if (texture_mipmaps_on_cpu) {
+        load_cached_texture_levels(compressed ? TextureCacheFormat::bc7_srgb : TextureCacheFormat::rgba8_srgb);
+    } else {
+        // Only the first level, the others are blitted from it on the GPU
+        texture_cache_hit = false;
+        texture_mip_chain.push_back(decode_texture_file(MappedFile(texture_path)));
+        const auto& level = texture_mip_chain.back();
+        texture_levels.push_back({level.width, level.height, level.pixels.data(), level.pixels.size()});
+    }
+
+    const auto& base_level = texture_levels.front();
+    texture_bytes = 0;
+    if (texture_mipmaps_on_cpu) {
+        mip_levels = static_cast<uint32_t>(texture_levels.size());
+        for (const auto& level : texture_levels) {
+            texture_bytes += level.size;
+        }
+    } else {
+        mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(base_level.width, base_level.height)))) + 1;
+        for (uint32_t i = 0; i < mip_levels; ++i) {
+            texture_bytes += static_cast<VkDeviceSize>(std::max(base_level.width >> i, 1u)) * std::max(base_level.height >> i, 1u) * 4;
+        }
+    }
 
-    create_buffer(image_size,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 staging_buffer, staging_buffer_memory);
-    {
-        void* data;
-        vkMapMemory(device, staging_buffer_memory, 0, image_size, 0, &data);
-            std::memcpy(data, pixels, static_cast<size_t>(image_size));
-        vkUnmapMemory(device, staging_buffer_memory);
+    texture_load_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+    std::cout << "Loaded a " << mip_levels << " level " << (compressed ? "BC7" : "RGBA8") << " texture of "
+              << texture_bytes / 1024 << " KiB " << (texture_cache_hit ? "from the texture cache" : "from " + texture_path)
+              << " with mips built on the " << (texture_mipmaps_on_cpu ? "CPU" : "GPU")
+              << " in " << std::fixed << std::setprecision(2) << texture_load_milliseconds << " ms\n\n";
+}
+
+void Application::load_cached_texture_levels(TextureCacheFormat format) {
+    bool compressed = (format == TextureCacheFormat::bc7_srgb);
+    const auto& cache_path = compressed ? bc7_texture_cache_path : rgba8_texture_cache_path;
+
+    MappedFile texture_file(texture_path);
+    uint64_t source_hash = hash_file(texture_file);
+    texture_cache_hit = texture_cache.load(cache_path, source_hash, format);
+    if (texture_cache_hit) {
+        texture_levels = texture_cache.get_levels();
+        return;
     }
 
-    stbi_image_free(pixels);
+    auto base_level = decode_texture_file(texture_file);
+    texture_mip_chain = build_mip_chain(base_level.pixels.data(), base_level.width, base_level.height, thread_pool);
 
-    create_image(texture_width, texture_height, mip_levels, VK_SAMPLE_COUNT_1_BIT,
-                 VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture_image, texture_image_memory);
+    // Blocks are independent, so every level is split into ranges of block rows
+    texture_encoded_levels.resize(compressed ? texture_mip_chain.size() : 0);
+    for (size_t i = 0; i < texture_mip_chain.size(); ++i) {
+        const auto& level = texture_mip_chain[i];
+        if (!compressed) {
+            texture_levels.push_back({level.width, level.height, level.pixels.data(), level.pixels.size()});
+            continue;
+        }
 
-    transition_image_layout(texture_image, VK_FORMAT_R8G8B8A8_SRGB, 
-                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mip_levels);
-    copy_buffer_to_image(staging_buffer, texture_image, static_cast<uint32_t>(texture_width), static_cast<uint32_t>(texture_height));
-    // transition_image_layout(texture_image, VK_FORMAT_R8G8B8A8_SRGB, 
-    //                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mip_levels);
-    // Done in mipmap generation
+        auto& encoded = texture_encoded_levels[i];
+        encoded.resize(get_bc7_size(level.width, level.height));
 
-    generate_mipmaps(texture_image, VK_FORMAT_R8G8B8A8_SRGB, texture_width, texture_height, mip_levels);
+        uint32_t block_rows = (level.height + 3) / 4;
+        thread_pool.parallel_for(thread_pool.get_worker_count() + 1, block_rows, [&] (uint32_t, size_t begin, size_t end) {
+            encode_bc7_rows(level.pixels.data(), level.width, level.height,
+                            static_cast<uint32_t>(begin), static_cast<uint32_t>(end), encoded.data());
+        });
+        texture_levels.push_back({level.width, level.height, encoded.data(), encoded.size()});
+    }
 
-    vkDestroyBuffer(device, staging_buffer, nullptr);
-    vkFreeMemory(device, staging_buffer_memory, nullptr);
+    try {
+        TextureCache::write(cache_path, source_hash, format, texture_levels);
+    } catch (const std::exception& e) {
+        std::cerr << "Texture cache not written: " << e.what() << '\n';
+    }
+}
+
+void Application::create_texture_image() {
+    const auto& base_level = texture_levels.front();
+    if (texture_mipmaps_on_cpu) {
+        create_image(base_level.width, base_level.height, mip_levels, VK_SAMPLE_COUNT_1_BIT,
+                     texture_format, VK_IMAGE_TILING_OPTIMAL,
+                     VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture_image, texture_image_allocation);
+
+        upload_image_levels(texture_levels, texture_image, texture_format);
+    } else {
+        create_image(base_level.width, base_level.height, mip_levels, VK_SAMPLE_COUNT_1_BIT,
+                     texture_format, VK_IMAGE_TILING_OPTIMAL,
+                     VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture_image, texture_image_allocation);
+
+        upload_image(base_level.data, base_level.size, texture_image, texture_format,
+                     base_level.width, base_level.height, mip_levels);
+    }
+
+    // Everything has been copied into staging memory
+    texture_levels.clear();
+    texture_mip_chain.clear();
+    texture_encoded_levels.clear();
+    texture_cache.close();
 }
 
 void Application::create_texture_image_view() {
-    texture_image_view = create_image_view(texture_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels);
+    texture_image_view = create_image_view(texture_image, texture_format, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels);
 }
 
 void Application::create_texture_sampler() {
@@ -1172,7 +2394,8 @@ void Application::create_texture_sampler() {
 
     sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     sampler_info.minLod = 0.0f;
-    sampler_info.maxLod = static_cast<float>(mip_levels);
+    // Shared by the placeholder and the streamed texture, the image views limit the levels
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
     sampler_info.mipLodBias = 0.0f;
 
     if (vkCreateSampler(device, &sampler_info, nullptr, &texture_sampler) != VK_SUCCESS) {
@@ -1180,16 +2403,15 @@ void Application::create_texture_sampler() {
     }
 }
 
-void Application::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-    auto command_buffer = begin_single_time_commands();
-
+void Application::copy_buffer_to_image(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize buffer_offset,
+                                       VkImage image, uint32_t width, uint32_t height, uint32_t mip_level) {
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = buffer_offset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
 
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.mipLevel = mip_level;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
 
@@ -1208,8 +2430,6 @@ void Application::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t
         1,
         &region
     );
-
-    end_single_time_commands(command_buffer);
 }
 
 VkSampleCountFlagBits Application::get_max_usable_sample_count() {
@@ -1228,37 +2448,61 @@ VkSampleCountFlagBits Application::get_max_usable_sample_count() {
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
+// Multisampled counts only, the render pass always resolves into a single sampled image
+std::vector<VkSampleCountFlagBits> Application::get_usable_sample_counts() {
+    VkPhysicalDeviceProperties physical_device_properties;
+    vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
+
+    VkSampleCountFlags counts = physical_device_properties.limits.framebufferColorSampleCounts & 
+                                physical_device_properties.limits.framebufferDepthSampleCounts;
+    std::vector<VkSampleCountFlagBits> usable_counts;
+    for (VkSampleCountFlags count = VK_SAMPLE_COUNT_2_BIT; count <= VK_SAMPLE_COUNT_64_BIT; count <<= 1) {
+        if (counts & count) {
+            usable_counts.push_back(static_cast<VkSampleCountFlagBits>(count));
+        }
+    }
+
+    if (usable_counts.empty()) {
+        usable_counts.push_back(VK_SAMPLE_COUNT_1_BIT);
+    }
+    return usable_counts;
+}
+
 void Application::create_color_resource() {
     VkFormat color_format = swap_chain_image_format;
 
-    create_image(swap_chain_extent.width, swap_chain_extent.height, 1, msaa_samples, color_format, 
+    create_image(render_target_extent.width, render_target_extent.height, 1, msaa_samples, color_format, 
                 VK_IMAGE_TILING_OPTIMAL, 
                 VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, color_image, color_image_memory);
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, color_image, color_image_allocation);
     color_image_view = create_image_view(color_image, color_format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 }
 
 void Application::create_depth_resource() {
     auto depth_format = find_depth_format();
-    create_image(swap_chain_extent.width, swap_chain_extent.height, 1, msaa_samples, depth_format, 
+    create_image(render_target_extent.width, render_target_extent.height, 1, msaa_samples, depth_format, 
                  VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 depth_image, depth_image_memory);
+                 depth_image, depth_image_allocation);
+    // No explicit transition, the render pass moves it out of UNDEFINED on every frame
     depth_image_view = create_image_view(depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-    transition_image_layout(depth_image, depth_format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
 }
 
 void Application::create_descriptor_pool() {
-    std::array<VkDescriptorPoolSize, 2> pool_sizes{};
+    // Room for the culling sets as well, one uniform and seven storage buffers per frame,
+    // and for the single meshlet set with six storage buffers
+    std::array<VkDescriptorPoolSize, 3> pool_sizes{};
     pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_sizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    pool_sizes[0].descriptorCount = static_cast<uint32_t>(2 * settings.frames_in_flight);
     pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    pool_sizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    pool_sizes[1].descriptorCount = static_cast<uint32_t>(settings.frames_in_flight);
+    pool_sizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[2].descriptorCount = static_cast<uint32_t>(7 * settings.frames_in_flight + 6);
 
     VkDescriptorPoolCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
     create_info.pPoolSizes = pool_sizes.data();
-    create_info.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    create_info.maxSets = static_cast<uint32_t>(2 * settings.frames_in_flight + 1);
 
     if (vkCreateDescriptorPool(device, &create_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor pool.");
@@ -1266,20 +2510,21 @@ void Application::create_descriptor_pool() {
 }
 
 void Application::create_descriptor_sets() {
-    std::vector<VkDescriptorSetLayout> descriptor_set_layouts(MAX_FRAMES_IN_FLIGHT, descriptor_set_layout);
+    std::vector<VkDescriptorSetLayout> descriptor_set_layouts(settings.frames_in_flight, descriptor_set_layout);
 
     VkDescriptorSetAllocateInfo alloc_info{};
     alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     alloc_info.descriptorPool = descriptor_pool;
-    alloc_info.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    alloc_info.descriptorSetCount = static_cast<uint32_t>(settings.frames_in_flight);
     alloc_info.pSetLayouts = descriptor_set_layouts.data();
 
-    descriptor_sets.resize(MAX_FRAMES_IN_FLIGHT);
+    descriptor_sets.resize(settings.frames_in_flight);
+    descriptor_texture_views.resize(settings.frames_in_flight);
     if (vkAllocateDescriptorSets(device, &alloc_info, descriptor_sets.data()) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate descriptor sets.");
     }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    for (size_t i = 0; i < settings.frames_in_flight; ++i) {
         VkDescriptorBufferInfo buffer_info{};
         buffer_info.buffer = uniform_buffers[i];
         buffer_info.offset = 0;
@@ -1287,8 +2532,9 @@ void Application::create_descriptor_sets() {
 
         VkDescriptorImageInfo image_info{};
         image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        image_info.imageView = texture_image_view;
+        image_info.imageView = (asset_state == AssetState::ready) ? texture_image_view : placeholder_texture_image_view;
         image_info.sampler = texture_sampler;
+        descriptor_texture_views[i] = image_info.imageView;
 
         std::array<VkWriteDescriptorSet, 2> descriptor_writes{};
         descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1325,28 +2571,61 @@ void Application::create_command_pool() {
 }
 
 void Application::create_sync_objects() {
-    image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
+    image_available_semaphores.resize(settings.frames_in_flight);
+    render_finished_semaphores.resize(settings.frames_in_flight);
+    frame_submissions.resize(settings.frames_in_flight, 0);
+    frame_input_times.resize(settings.frames_in_flight);
 
+    // Binary semaphores remain for the swapchain, acquire and present do not accept timeline semaphores
     VkSemaphoreCreateInfo semaphore_creat_info{};
     semaphore_creat_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fence_create_info{};
-    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i){
+    for (size_t i = 0; i < settings.frames_in_flight; ++i){
         if (vkCreateSemaphore(device, &semaphore_creat_info, nullptr, &image_available_semaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphore_creat_info, nullptr, &render_finished_semaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fence_create_info, nullptr, &in_flight_fences[i]) != VK_SUCCESS) {
+            vkCreateSemaphore(device, &semaphore_creat_info, nullptr, &render_finished_semaphores[i]) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to create semaphores.");
         }
     }    
 }
 
+void Application::create_timeline_semaphores() {
+    VkSemaphoreTypeCreateInfo type_create_info{};
+    type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_create_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_create_info{};
+    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_create_info.pNext = &type_create_info;
+
+    if (vkCreateSemaphore(device, &semaphore_create_info, nullptr, &gpu_timeline) != VK_SUCCESS ||
+        vkCreateSemaphore(device, &semaphore_create_info, nullptr, &transfer_timeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timeline semaphores.");
+    }
+}
+
+void Application::wait_for_submission(uint64_t submission) {
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &gpu_timeline;
+    wait_info.pValues = &submission;
+
+    if (vkWaitSemaphores(device, &wait_info, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to wait for submission " + std::to_string(submission) + ".");
+    }
+}
+
+uint64_t Application::get_completed_submission() {
+    uint64_t completed_submission = 0;
+    if (vkGetSemaphoreCounterValue(device, gpu_timeline, &completed_submission) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to query the GPU timeline.");
+    }
+    return completed_submission;
+}
+
 void Application::create_command_buffers() {
-    command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+    command_buffers.resize(settings.frames_in_flight);
 
     VkCommandBufferAllocateInfo allocate_info{};
     allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1370,7 +2649,7 @@ void Application::record_command_buffer(VkCommandBuffer _command_buffer, uint32_
     VkRenderPassBeginInfo render_pass_begin_info{};
     render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_begin_info.renderPass = render_pass;
-    render_pass_begin_info.framebuffer = swap_chain_framebuffers[image_index];
+    render_pass_begin_info.framebuffer = use_dynamic_rendering ? VK_NULL_HANDLE : swap_chain_framebuffers[image_index];
     render_pass_begin_info.renderArea.offset = {0, 0};
     render_pass_begin_info.renderArea.extent = swap_chain_extent;
     std::array<VkClearValue, 2> clear_values{};
@@ -1379,7 +2658,163 @@ void Application::record_command_buffer(VkCommandBuffer _command_buffer, uint32_
     render_pass_begin_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
     render_pass_begin_info.pClearValues = clear_values.data();
 
-    vkCmdBeginRenderPass(_command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    bool write_timestamps = (timestamp_query_pool != VK_NULL_HANDLE) && is_benchmark_recording();
+    if (write_timestamps) {
+        vkCmdResetQueryPool(_command_buffer, timestamp_query_pool, 2 * current_frame, 2);
+        vkCmdWriteTimestamp(_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_query_pool, 2 * current_frame);
+    }
+
+    // Decided per frame, as the vertex pipeline stands in while the mesh shading variant compiles
+    // or after it failed to. Mesh shading culls in the task shader instead
+    if (settings.gpu_culling && asset_state == AssetState::ready && !pipeline_key.mesh_shading) {
+        record_culling(_command_buffer);
+    }
+
+    if (recording_slice_count > 1) {
+        record_secondary_command_buffers(image_index);
+
+        if (use_dynamic_rendering) {
+            begin_dynamic_rendering(_command_buffer, image_index, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR);
+        } else {
+            vkCmdBeginRenderPass(_command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        }
+        vkCmdExecuteCommands(_command_buffer, recording_slice_count,
+                             &secondary_command_buffers[current_frame * recording_slice_count]);
+    } else {
+        if (use_dynamic_rendering) {
+            begin_dynamic_rendering(_command_buffer, image_index, 0);
+        } else {
+            vkCmdBeginRenderPass(_command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        }
+        record_draws(_command_buffer, 0, draw_push_constants.size());
+    }
+
+    if (use_dynamic_rendering) {
+        end_dynamic_rendering(_command_buffer, image_index);
+    } else {
+        vkCmdEndRenderPass(_command_buffer);
+    }
+
+    if (write_timestamps) {
+        vkCmdWriteTimestamp(_command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_query_pool, 2 * current_frame + 1);
+        timestamps_pending[current_frame] = true;
+    }
+
+    if (vkEndCommandBuffer(_command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record command buffer.");
+    }
+}
+
+void Application::begin_dynamic_rendering(VkCommandBuffer _command_buffer, uint32_t image_index, VkRenderingFlagsKHR flags) {
+    VkFormat depth_format = find_depth_format();
+    bool multisampled = (msaa_samples != VK_SAMPLE_COUNT_1_BIT);
+
+    // Previous contents are cleared anyway, so every attachment starts out UNDEFINED like in the render pass
+    std::array<VkImageMemoryBarrier, 3> barriers{};
+    for (auto& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+
+    barriers[0].image = swap_chain_images[image_index];
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    barriers[1].image = depth_image;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (has_stencil_component(depth_format)) {
+        barriers[1].subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    barriers[2].image = color_image;
+    barriers[2].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barriers[2].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barriers[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[2].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    vkCmdPipelineBarrier(_command_buffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                         VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         multisampled ? 3 : 2, barriers.data());
+
+    // Without multisampling the swapchain image is rendered to directly, nothing to resolve
+    VkRenderingAttachmentInfoKHR color_attachment{};
+    color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.clearValue.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    if (multisampled) {
+        color_attachment.imageView = color_image_view;
+        color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        color_attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+        color_attachment.resolveImageView = swap_chain_image_views[image_index];
+        color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    } else {
+        color_attachment.imageView = swap_chain_image_views[image_index];
+        color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    }
+
+    VkRenderingAttachmentInfoKHR depth_attachment{};
+    depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depth_attachment.imageView = depth_image_view;
+    depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.clearValue.depthStencil = {1.0f, 0};
+
+    VkRenderingInfoKHR rendering_info{};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    rendering_info.flags = flags;
+    rendering_info.renderArea.offset = {0, 0};
+    rendering_info.renderArea.extent = swap_chain_extent;
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments = &color_attachment;
+    rendering_info.pDepthAttachment = &depth_attachment;
+
+    cmd_begin_rendering(_command_buffer, &rendering_info);
+}
+
+void Application::end_dynamic_rendering(VkCommandBuffer _command_buffer, uint32_t image_index) {
+    cmd_end_rendering(_command_buffer);
+
+    // The final layout of the resolve attachment in the render pass path
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.newLayout = settings.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swap_chain_images[image_index];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+
+    vkCmdPipelineBarrier(_command_buffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &barrier);
+}
+
+void Application::record_draws(VkCommandBuffer _command_buffer, size_t first_draw, size_t end_draw) {
     vkCmdBindPipeline(_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
 
     VkViewport viewport{};
@@ -1396,115 +2831,883 @@ void Application::record_command_buffer(VkCommandBuffer _command_buffer, uint32_
     scissor.extent = swap_chain_extent;
     vkCmdSetScissor(_command_buffer, 0, 1, &scissor);
 
-    VkBuffer vertex_buffers[] = {vertex_buffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(_command_buffer, 0, 1, vertex_buffers, offsets);
-
-    vkCmdBindIndexBuffer(_command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT32);
-
     vkCmdBindDescriptorSets(_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout,
                              0, 1, &descriptor_sets[current_frame], 0, nullptr);
 
-    vkCmdDrawIndexed(_command_buffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+    // Every instance of the placeholder is drawn, it is not worth culling
+    if (asset_state != AssetState::ready) {
+        VkBuffer placeholder_vertex_buffers[] = {placeholder_vertex_buffer, instance_buffer};
+        VkDeviceSize placeholder_offsets[] = {0, 0};
+        vkCmdBindVertexBuffers(_command_buffer, 0, 2, placeholder_vertex_buffers, placeholder_offsets);
+        vkCmdBindIndexBuffer(_command_buffer, placeholder_index_buffer, 0, VK_INDEX_TYPE_UINT16);
+
+        auto placeholder_push_constants = get_mesh_push_constants(placeholder_quantization);
+        vkCmdPushConstants(_command_buffer, pipeline_layout, push_constant_stages,
+                           sizeof(DrawPushConstants), sizeof(MeshPushConstants), &placeholder_push_constants);
+
+        for (size_t i = first_draw; i < end_draw; ++i) {
+            vkCmdPushConstants(_command_buffer, pipeline_layout, push_constant_stages,
+                               0, sizeof(DrawPushConstants), &draw_push_constants[i]);
+            vkCmdDrawIndexed(_command_buffer, placeholder_index_count, settings.instance_count, 0, 0, 0);
+        }
+        return;
+    }
 
-    vkCmdEndRenderPass(_command_buffer);
+    auto mesh_push_constants = get_mesh_push_constants(model_quantization);
+    mesh_push_constants.bounding_sphere = glm::vec4(bounding_sphere[0], bounding_sphere[1], bounding_sphere[2], bounding_sphere[3]);
+    vkCmdPushConstants(_command_buffer, pipeline_layout, push_constant_stages,
+                       sizeof(DrawPushConstants), sizeof(MeshPushConstants), &mesh_push_constants);
 
-    if (vkEndCommandBuffer(_command_buffer) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to record command buffer.");
+    // Workgroups along x take 32 meshlets each of the level of detail of their instance, the
+    // ones along y are the instances
+    if (pipeline_key.mesh_shading) {
+        vkCmdBindDescriptorSets(_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout,
+                                1, 1, &meshlet_descriptor_set, 0, nullptr);
+
+        uint32_t task_group_count = (max_lod_meshlet_count + meshlets_per_task_group - 1) / meshlets_per_task_group;
+        for (size_t i = first_draw; i < end_draw; ++i) {
+            vkCmdPushConstants(_command_buffer, pipeline_layout, push_constant_stages,
+                               0, sizeof(DrawPushConstants), &draw_push_constants[i]);
+            cmd_draw_mesh_tasks(_command_buffer, task_group_count, settings.instance_count, 1);
+        }
+        return;
+    }
+
+    // Cluster culling picks instances from the instance buffer itself, instance culling compacts them per draw
+    bool compacted_instances = settings.gpu_culling && !use_cluster_culling;
+    VkBuffer vertex_buffers[] = {vertex_buffer, instance_buffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(_command_buffer, 0, compacted_instances ? 1 : 2, vertex_buffers, offsets);
+
+    vkCmdBindIndexBuffer(_command_buffer, index_buffer, 0, index_type);
+
+    for (size_t i = first_draw; i < end_draw; ++i) {
+        vkCmdPushConstants(_command_buffer, pipeline_layout, push_constant_stages,
+                           0, sizeof(DrawPushConstants), &draw_push_constants[i]);
+
+        // Every visible meshlet of the draw, up to the count the culling pass wrote
+        if (use_cluster_culling) {
+            uint32_t commands_per_draw = settings.instance_count * max_lod_meshlet_count;
+            vkCmdDrawIndexedIndirectCount(_command_buffer, culled_indirect_buffers[current_frame],
+                                          i * commands_per_draw * sizeof(VkDrawIndexedIndirectCommand),
+                                          cull_count_buffers[current_frame], i * sizeof(uint32_t),
+                                          commands_per_draw, sizeof(VkDrawIndexedIndirectCommand));
+            continue;
+        }
+
+        // One command per index range, issued separately so multiDrawIndirect is not required
+        if (settings.gpu_culling) {
+            // Each level of detail of a draw reads its own run of compacted instances and its own indirect commands
+            for (size_t lod = 0; lod < lods.size(); ++lod) {
+                VkDeviceSize instance_offset = (i * lods.size() + lod) * settings.instance_count * sizeof(InstanceData);
+                vkCmdBindVertexBuffers(_command_buffer, 1, 1, &visible_instance_buffers[current_frame], &instance_offset);
+                for (size_t range = lods[lod].first_range; range < lods[lod].first_range + lods[lod].range_count; ++range) {
+                    vkCmdDrawIndexedIndirect(_command_buffer, culled_indirect_buffers[current_frame],
+                                             (i * index_ranges.size() + range) * sizeof(VkDrawIndexedIndirectCommand),
+                                             1, sizeof(VkDrawIndexedIndirectCommand));
+                }
+            }
+        } else {
+            for (size_t range = 0; range < lods[0].range_count; ++range) {
+                vkCmdDrawIndexedIndirect(_command_buffer, indirect_buffer, range * sizeof(VkDrawIndexedIndirectCommand),
+                                         1, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+    }
+}
+
+void Application::create_draw_push_constants() {
+    // Copies are shrunk to fit a grid covering the footprint of a single model
+    uint32_t grid_size = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(settings.draw_count))));
+    float cell_size = 2.0f / grid_size;
+
+    draw_push_constants.resize(settings.draw_count);
+    for (uint32_t i = 0; i < settings.draw_count; ++i) {
+        float x = -1.0f + cell_size * (i % grid_size + 0.5f);
+        float y = -1.0f + cell_size * (i / grid_size + 0.5f);
+        draw_push_constants[i].offset_scale = (grid_size == 1) ? glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+                                                               : glm::vec4(x, y, 0.0f, 1.0f / grid_size);
+    }
+}
+
+void Application::create_cull_descriptor_set_layout() {
+    if (!settings.gpu_culling) return;
+
+    std::array<VkDescriptorSetLayoutBinding, 8> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = (i == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    create_info.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &create_info, nullptr, &cull_descriptor_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create cull descriptor set layout.");
     }
 }
 
-VkCommandBuffer Application::begin_single_time_commands() {
+void Application::create_cull_pipeline() {
+    if (!settings.gpu_culling) return;
+
+    auto comp_shader_module = create_shader_module("shaders/cull_comp.spv");
+
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info{};
+    pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.setLayoutCount = 1;
+    pipeline_layout_create_info.pSetLayouts = &cull_descriptor_set_layout;
+    pipeline_layout_create_info.pushConstantRangeCount = 1;
+    pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+    if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &cull_pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create cull pipeline layout.");
+    }
+
+    VkComputePipelineCreateInfo pipeline_create_info{};
+    pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_create_info.stage.module = comp_shader_module;
+    pipeline_create_info.stage.pName = "main";
+    pipeline_create_info.layout = cull_pipeline_layout;
+
+    if (vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &cull_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create cull pipeline.");
+    }
+
+    vkDestroyShaderModule(device, comp_shader_module, nullptr);
+}
+
+void Application::create_cluster_cull_pipeline() {
+    auto comp_shader_module = create_shader_module("shaders/cull_comp.spv");
+
+    // The instance culling shader with its cluster_culling constant set
+    VkBool32 cluster_culling_constant = VK_TRUE;
+    VkSpecializationMapEntry map_entry{0, 0, sizeof(VkBool32)};
+
+    VkSpecializationInfo specialization_info{};
+    specialization_info.mapEntryCount = 1;
+    specialization_info.pMapEntries = &map_entry;
+    specialization_info.dataSize = sizeof(VkBool32);
+    specialization_info.pData = &cluster_culling_constant;
+
+    VkComputePipelineCreateInfo pipeline_create_info{};
+    pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_create_info.stage.module = comp_shader_module;
+    pipeline_create_info.stage.pName = "main";
+    pipeline_create_info.stage.pSpecializationInfo = &specialization_info;
+    pipeline_create_info.layout = cull_pipeline_layout;
+
+    if (vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &cluster_cull_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create cluster cull pipeline.");
+    }
+
+    vkDestroyShaderModule(device, comp_shader_module, nullptr);
+}
+
+void Application::create_cull_buffers() {
+    if (!settings.gpu_culling) return;
+
+    VkDeviceSize placement_buffer_size = get_vector_data_size(draw_push_constants);
+    create_buffer(placement_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, draw_placement_buffer, draw_placement_buffer_allocation);
+    upload_buffer(draw_push_constants.data(), placement_buffer_size, draw_placement_buffer,
+                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void Application::create_culled_indirect_buffers() {
+    if (!settings.gpu_culling) return;
+
+    // Mesh shading culls meshlets in the task shader, so the pass only has to cover the vertex pipeline
+    // in its place and culls whole instances without any per meshlet commands. Known only now, as the
+    // meshlet limits can still rule out mesh shading
+    if (use_mesh_shading) {
+        use_cluster_culling = false;
+    }
+
+    // Room for every meshlet of every instance of every draw, which only fits for modest scenes
+    VkDeviceSize cluster_buffer_size = static_cast<VkDeviceSize>(settings.draw_count) * settings.instance_count *
+                                       max_lod_meshlet_count * sizeof(VkDrawIndexedIndirectCommand);
+    if (use_cluster_culling && cluster_buffer_size > max_cluster_command_bytes) {
+        std::cerr << "Cluster culling would need " << cluster_buffer_size / (1024 * 1024)
+                  << " MiB of commands per frame, culling instances instead\n";
+        use_cluster_culling = false;
+    }
+    if (use_cluster_culling) {
+        create_cluster_cull_pipeline();
+    }
+
+    VkDeviceSize buffer_size = cluster_buffer_size;
+    if (!use_cluster_culling) {
+        // One command per index range of every draw, so these wait for the model. The template holds
+        // them without instances and is copied over the buffer of the frame before culling
+        std::vector<VkDrawIndexedIndirectCommand> draw_commands(settings.draw_count * index_ranges.size());
+        for (size_t i = 0; i < draw_commands.size(); ++i) {
+            const auto& range = index_ranges[i % index_ranges.size()];
+            draw_commands[i].indexCount = range.index_count;
+            draw_commands[i].instanceCount = 0;
+            draw_commands[i].firstIndex = range.first_index;
+            draw_commands[i].vertexOffset = range.vertex_offset;
+            draw_commands[i].firstInstance = 0;
+        }
+
+        buffer_size = get_vector_data_size(draw_commands);
+        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cull_command_template_buffer, cull_command_template_buffer_allocation);
+        upload_buffer(draw_commands.data(), buffer_size, cull_command_template_buffer,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+
+    // Compacted instances, a run of instance_count for every level of detail of every draw. Cluster
+    // culling draws from the instance buffer itself and only needs something to bind
+    VkDeviceSize instance_buffer_size = sizeof(InstanceData);
+    if (!use_cluster_culling) {
+        instance_buffer_size *= static_cast<VkDeviceSize>(settings.draw_count) * lods.size() * settings.instance_count;
+    }
+
+    // The counts are only read with cluster culling, but the instance culling pipeline has the binding too
+    visible_instance_buffers.resize(settings.frames_in_flight);
+    visible_instance_buffers_allocations.resize(settings.frames_in_flight);
+    culled_indirect_buffers.resize(settings.frames_in_flight);
+    culled_indirect_buffers_allocations.resize(settings.frames_in_flight);
+    cull_count_buffers.resize(settings.frames_in_flight);
+    cull_count_buffers_allocations.resize(settings.frames_in_flight);
+    for (size_t i = 0; i < settings.frames_in_flight; ++i) {
+        create_buffer(instance_buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, visible_instance_buffers[i], visible_instance_buffers_allocations[i]);
+        create_buffer(buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, culled_indirect_buffers[i], culled_indirect_buffers_allocations[i]);
+        create_buffer(settings.draw_count * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cull_count_buffers[i], cull_count_buffers_allocations[i]);
+    }
+}
+
+void Application::create_cull_descriptor_sets() {
+    if (!settings.gpu_culling) return;
+
+    std::vector<VkDescriptorSetLayout> descriptor_set_layouts(settings.frames_in_flight, cull_descriptor_set_layout);
+
+    VkDescriptorSetAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool;
+    alloc_info.descriptorSetCount = static_cast<uint32_t>(settings.frames_in_flight);
+    alloc_info.pSetLayouts = descriptor_set_layouts.data();
+
+    cull_descriptor_sets.resize(settings.frames_in_flight);
+    if (vkAllocateDescriptorSets(device, &alloc_info, cull_descriptor_sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate cull descriptor sets.");
+    }
+
+    for (size_t i = 0; i < settings.frames_in_flight; ++i) {
+        std::array<VkDescriptorBufferInfo, 3> buffer_infos{};
+        buffer_infos[0] = {uniform_buffers[i], 0, sizeof(UniformBufferObject)};
+        buffer_infos[1] = {instance_buffer, 0, VK_WHOLE_SIZE};
+        buffer_infos[2] = {draw_placement_buffer, 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 3> descriptor_writes{};
+        for (uint32_t binding = 0; binding < descriptor_writes.size(); ++binding) {
+            descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_writes[binding].dstSet = cull_descriptor_sets[i];
+            descriptor_writes[binding].dstBinding = binding;
+            descriptor_writes[binding].dstArrayElement = 0;
+            descriptor_writes[binding].descriptorType = (binding == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptor_writes[binding].descriptorCount = 1;
+            descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+        }
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+    }
+
+    if (asset_state == AssetState::ready) {
+        write_culled_indirect_descriptors();
+    }
+}
+
+void Application::write_culled_indirect_descriptors() {
+    if (!settings.gpu_culling) return;
+
+    // No frame culls before the assets are ready, so none of the sets can be in use yet
+    for (size_t i = 0; i < settings.frames_in_flight; ++i) {
+        std::array<VkDescriptorBufferInfo, 5> buffer_infos{};
+        buffer_infos[0] = {visible_instance_buffers[i], 0, VK_WHOLE_SIZE};
+        buffer_infos[1] = {culled_indirect_buffers[i], 0, VK_WHOLE_SIZE};
+        buffer_infos[2] = {meshlet_buffer, 0, VK_WHOLE_SIZE};
+        buffer_infos[3] = {cull_count_buffers[i], 0, VK_WHOLE_SIZE};
+        buffer_infos[4] = {lod_buffer, 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 5> descriptor_writes{};
+        for (uint32_t j = 0; j < descriptor_writes.size(); ++j) {
+            descriptor_writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptor_writes[j].dstSet = cull_descriptor_sets[i];
+            descriptor_writes[j].dstBinding = 3 + j;
+            descriptor_writes[j].dstArrayElement = 0;
+            descriptor_writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptor_writes[j].descriptorCount = 1;
+            descriptor_writes[j].pBufferInfo = &buffer_infos[j];
+        }
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+    }
+}
+
+void Application::record_culling(VkCommandBuffer _command_buffer) {
+    // Instance counts are accumulated with atomics, so every command starts out from the template without
+    // instances. Cluster culling appends whole commands instead and only the counts start from zero
+    if (use_cluster_culling) {
+        vkCmdFillBuffer(_command_buffer, cull_count_buffers[current_frame], 0, VK_WHOLE_SIZE, 0);
+    } else {
+        VkBufferCopy command_copy{};
+        command_copy.size = static_cast<VkDeviceSize>(settings.draw_count) * index_ranges.size() * sizeof(VkDrawIndexedIndirectCommand);
+        vkCmdCopyBuffer(_command_buffer, cull_command_template_buffer, culled_indirect_buffers[current_frame], 1, &command_copy);
+    }
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(_command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &barrier,
+                         0, nullptr,
+                         0, nullptr);
+
+    vkCmdBindPipeline(_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, use_cluster_culling ? cluster_cull_pipeline : cull_pipeline);
+    vkCmdBindDescriptorSets(_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_layout,
+                            0, 1, &cull_descriptor_sets[current_frame], 0, nullptr);
+
+    CullPushConstants push_constants{};
+    push_constants.bounding_sphere = glm::vec4(bounding_sphere[0], bounding_sphere[1], bounding_sphere[2], bounding_sphere[3]);
+    push_constants.range_count = static_cast<uint32_t>(index_ranges.size());
+    push_constants.instance_count = settings.instance_count;
+    push_constants.draw_count = settings.draw_count;
+    push_constants.meshlet_count = max_lod_meshlet_count;
+    vkCmdPushConstants(_command_buffer, cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(CullPushConstants), &push_constants);
+
+    // The shader loops over the remainder when the dispatch would exceed the guaranteed group count limit
+    constexpr uint64_t group_size = 64;
+    constexpr uint64_t max_group_count = 65535;
+    uint64_t object_count = static_cast<uint64_t>(settings.instance_count) * settings.draw_count;
+    if (use_cluster_culling) {
+        object_count *= max_lod_meshlet_count;
+    }
+    uint32_t group_count = static_cast<uint32_t>(std::min((object_count + group_size - 1) / group_size, max_group_count));
+    vkCmdDispatch(_command_buffer, group_count, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(_command_buffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                         1, &barrier,
+                         0, nullptr,
+                         0, nullptr);
+}
+
+void Application::create_recording_command_pools() {
+    uint32_t thread_count = thread_pool.get_worker_count() + 1;
+    recording_slice_count = (settings.record_threads == 0) ? thread_count : std::min(settings.record_threads, thread_count);
+    if (recording_slice_count <= 1) {
+        recording_slice_count = 1;
+        return;
+    }
+
+    recording_command_pools.resize(settings.frames_in_flight * recording_slice_count);
+    secondary_command_buffers.resize(settings.frames_in_flight * recording_slice_count);
+
+    VkCommandPoolCreateInfo pool_create_info{};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_create_info.queueFamilyIndex = graphics_queue_family;
+
+    VkCommandBufferAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocate_info.commandBufferCount = 1;
+
+    for (size_t i = 0; i < recording_command_pools.size(); ++i) {
+        if (vkCreateCommandPool(device, &pool_create_info, nullptr, &recording_command_pools[i]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create recording command pool.");
+        }
+
+        allocate_info.commandPool = recording_command_pools[i];
+        if (vkAllocateCommandBuffers(device, &allocate_info, &secondary_command_buffers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate secondary command buffers.");
+        }
+    }
+
+    std::cout << "Recording draws on " << recording_slice_count << " threads\n\n";
+}
+
+void Application::record_secondary_command_buffers(uint32_t image_index) {
+    VkFormat color_format = swap_chain_image_format;
+    VkCommandBufferInheritanceRenderingInfoKHR inheritance_rendering_info{};
+    inheritance_rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+    inheritance_rendering_info.colorAttachmentCount = 1;
+    inheritance_rendering_info.pColorAttachmentFormats = &color_format;
+    inheritance_rendering_info.depthAttachmentFormat = find_depth_format();
+    inheritance_rendering_info.rasterizationSamples = msaa_samples;
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    if (use_dynamic_rendering) {
+        inheritance_info.pNext = &inheritance_rendering_info;
+    } else {
+        inheritance_info.renderPass = render_pass;
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer = swap_chain_framebuffers[image_index];
+    }
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    // Exceptions must not escape the workers, the first failure is rethrown after all slices finish
+    std::atomic<bool> failed = false;
+    thread_pool.parallel_for(recording_slice_count, draw_push_constants.size(), [&] (uint32_t slice, size_t begin, size_t end) {
+        size_t index = current_frame * recording_slice_count + slice;
+        auto secondary_command_buffer = secondary_command_buffers[index];
+
+        vkResetCommandPool(device, recording_command_pools[index], 0);
+        if (vkBeginCommandBuffer(secondary_command_buffer, &begin_info) != VK_SUCCESS) {
+            failed = true;
+            return;
+        }
+        record_draws(secondary_command_buffer, begin, end);
+        if (vkEndCommandBuffer(secondary_command_buffer) != VK_SUCCESS) {
+            failed = true;
+        }
+    });
+
+    if (failed) {
+        throw std::runtime_error("Failed to record secondary command buffers.");
+    }
+}
+
+bool Application::has_dedicated_transfer_queue() {
+    return transfer_queue_family != graphics_queue_family;
+}
+
+void Application::create_upload_context() {
+    if (has_dedicated_transfer_queue()) {
+        VkCommandPoolCreateInfo pool_create_info{};
+        pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_create_info.queueFamilyIndex = transfer_queue_family;
+
+        if (vkCreateCommandPool(device, &pool_create_info, nullptr, &transfer_command_pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create transfer command pool.");
+        }
+    } else {
+        transfer_command_pool = command_pool;
+    }
+
     VkCommandBufferAllocateInfo allocate_info{};
     allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocate_info.commandPool = command_pool;
     allocate_info.commandBufferCount = 1;
 
-    VkCommandBuffer command_buffer;
-    vkAllocateCommandBuffers(device, &allocate_info, &command_buffer);
+    allocate_info.commandPool = command_pool;
+    if (vkAllocateCommandBuffers(device, &allocate_info, &upload_graphics_command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate upload command buffers.");
+    }
+
+    // With a single queue family everything is recorded into one command buffer
+    if (has_dedicated_transfer_queue()) {
+        allocate_info.commandPool = transfer_command_pool;
+        if (vkAllocateCommandBuffers(device, &allocate_info, &upload_transfer_command_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate upload command buffers.");
+        }
+    } else {
+        upload_transfer_command_buffer = upload_graphics_command_buffer;
+    }
+
+    staging_ring.init(device, allocator, staging_ring_size);
+
+    std::cout << "Uploads use " << (has_dedicated_transfer_queue() ? "a dedicated transfer" : "the graphics")
+              << " queue (family " << transfer_queue_family << ")\n\n";
+}
+
+StagingRegion Application::stage_upload_data(const void* data, VkDeviceSize size) {
+    StagingRegion region;
+    if (!staging_ring.allocate(size, staging_alignment, region)) {
+        Allocation staging_buffer_allocation;
+        create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      region.buffer, staging_buffer_allocation);
+        region.size = size;
+        region.mapped = staging_buffer_allocation.mapped;
+        upload_staging_buffers.emplace_back(region.buffer, staging_buffer_allocation);
+    }
 
+    std::memcpy(region.mapped, data, static_cast<size_t>(size));
+    return region;
+}
+
+void Application::begin_uploads() {
     VkCommandBufferBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    vkBeginCommandBuffer(command_buffer, &begin_info);
+    vkBeginCommandBuffer(upload_graphics_command_buffer, &begin_info);
+    if (has_dedicated_transfer_queue()) {
+        vkBeginCommandBuffer(upload_transfer_command_buffer, &begin_info);
+    }
+}
 
-    return command_buffer;
+void Application::upload_vertices(const Vertex* vertices, uint32_t _vertex_count, const VertexQuantization& quantization, VkBuffer dst_buffer) {
+    // Converted on the CPU right before staging, the mesh cache keeps full precision vertices
+    std::vector<uint8_t> encoded_vertices(static_cast<size_t>(_vertex_count) * GpuVertexLayout::stride);
+    GpuVertexLayout::encode(vertices, _vertex_count, quantization, encoded_vertices.data());
+
+    upload_buffer(encoded_vertices.data(), encoded_vertices.size(), dst_buffer,
+                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 }
 
-void Application::end_single_time_commands(VkCommandBuffer command_buffer) {
-    vkEndCommandBuffer(command_buffer);
+void Application::upload_buffer(const void* data, VkDeviceSize size, VkBuffer dst_buffer,
+                                VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+    auto staging = stage_upload_data(data, size);
 
-    VkSubmitInfo submit_info{};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer;
+    copy_buffer(upload_transfer_command_buffer, staging.buffer, staging.offset, dst_buffer, size);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.buffer = dst_buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+    if (!has_dedicated_transfer_queue()) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dst_access;
+        vkCmdPipelineBarrier(upload_graphics_command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0,
+                             0, nullptr,
+                             1, &barrier,
+                             0, nullptr);
+        return;
+    }
 
-    vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphics_queue);
+    // Release from the transfer family, then acquire on the graphics family after the semaphore
+    barrier.srcQueueFamilyIndex = transfer_queue_family;
+    barrier.dstQueueFamilyIndex = graphics_queue_family;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(upload_transfer_command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr,
+                         1, &barrier,
+                         0, nullptr);
 
-    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(upload_graphics_command_buffer,
+                         dst_stage, dst_stage, 0,
+                         0, nullptr,
+                         1, &barrier,
+                         0, nullptr);
 }
 
-void Application::draw_frame() {
-    vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+void Application::upload_image(const void* data, VkDeviceSize size, VkImage image, VkFormat format,
+                               uint32_t width, uint32_t height, uint32_t _mip_levels) {
+    auto staging = stage_upload_data(data, size);
+
+    transition_image_layout(upload_transfer_command_buffer, image, format,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, _mip_levels);
+    copy_buffer_to_image(upload_transfer_command_buffer, staging.buffer, staging.offset, image, width, height);
+
+    // Blits need a graphics queue, so ownership moves over before the mip chain is built.
+    // The layout stays TRANSFER_DST_OPTIMAL across the transfer
+    if (has_dedicated_transfer_queue()) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.image = image;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = transfer_queue_family;
+        barrier.dstQueueFamilyIndex = graphics_queue_family;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = _mip_levels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(upload_transfer_command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
 
-    uint32_t image_index;
-    auto result = vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_index);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreate_swap_chain();
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(upload_graphics_command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+    }
+
+    generate_mipmaps(upload_graphics_command_buffer, image, format,
+                     static_cast<int32_t>(width), static_cast<int32_t>(height), _mip_levels);
+}
+
+void Application::upload_image_levels(const std::vector<TextureLevel>& levels, VkImage image, VkFormat format) {
+    auto level_count = static_cast<uint32_t>(levels.size());
+    transition_image_layout(upload_transfer_command_buffer, image, format,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, level_count);
+
+    // Staged one level at a time, so a large chain can fall back to dedicated buffers level by level
+    for (uint32_t i = 0; i < level_count; ++i) {
+        auto staging = stage_upload_data(levels[i].data, levels[i].size);
+        copy_buffer_to_image(upload_transfer_command_buffer, staging.buffer, staging.offset, image,
+                             levels[i].width, levels[i].height, i);
+    }
+
+    if (!has_dedicated_transfer_queue()) {
+        transition_image_layout(upload_graphics_command_buffer, image, format,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, level_count);
         return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("Failed to acquire swap chain image.");
     }
 
-    vkResetFences(device, 1, &in_flight_fences[current_frame]);
+    // Release from the transfer family and acquire on the graphics family, with the same layout transition in both
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = transfer_queue_family;
+    barrier.dstQueueFamilyIndex = graphics_queue_family;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = level_count;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(upload_transfer_command_buffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(upload_graphics_command_buffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &barrier);
+}
+
+void Application::submit_uploads() {
+    vkEndCommandBuffer(upload_graphics_command_buffer);
+
+    uint64_t transfer_submission = 0;
+    uint64_t graphics_submission = submission_count + 1;
+
+    VkTimelineSemaphoreSubmitInfo graphics_timeline_info{};
+    graphics_timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    graphics_timeline_info.signalSemaphoreValueCount = 1;
+    graphics_timeline_info.pSignalSemaphoreValues = &graphics_submission;
+
+    VkSubmitInfo graphics_submit_info{};
+    graphics_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    graphics_submit_info.pNext = &graphics_timeline_info;
+    graphics_submit_info.commandBufferCount = 1;
+    graphics_submit_info.pCommandBuffers = &upload_graphics_command_buffer;
+    graphics_submit_info.signalSemaphoreCount = 1;
+    graphics_submit_info.pSignalSemaphores = &gpu_timeline;
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    if (has_dedicated_transfer_queue()) {
+        vkEndCommandBuffer(upload_transfer_command_buffer);
+        transfer_submission = ++transfer_submission_count;
+
+        VkTimelineSemaphoreSubmitInfo transfer_timeline_info{};
+        transfer_timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        transfer_timeline_info.signalSemaphoreValueCount = 1;
+        transfer_timeline_info.pSignalSemaphoreValues = &transfer_submission;
+
+        VkSubmitInfo transfer_submit_info{};
+        transfer_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transfer_submit_info.pNext = &transfer_timeline_info;
+        transfer_submit_info.commandBufferCount = 1;
+        transfer_submit_info.pCommandBuffers = &upload_transfer_command_buffer;
+        transfer_submit_info.signalSemaphoreCount = 1;
+        transfer_submit_info.pSignalSemaphores = &transfer_timeline;
+
+        if (vkQueueSubmit(transfer_queue, 1, &transfer_submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit transfer command buffer.");
+        }
+
+        graphics_timeline_info.waitSemaphoreValueCount = 1;
+        graphics_timeline_info.pWaitSemaphoreValues = &transfer_submission;
+        graphics_submit_info.waitSemaphoreCount = 1;
+        graphics_submit_info.pWaitSemaphores = &transfer_timeline;
+        graphics_submit_info.pWaitDstStageMask = &wait_stage;
+    }
+
+    // The graphics submission waits on the transfer one, so its timeline value covers the whole batch
+    if (vkQueueSubmit(graphics_queue, 1, &graphics_submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit upload command buffer.");
+    }
+    upload_submission = ++submission_count;
+    staging_ring.submit(upload_submission);
+    uploads_in_flight = true;
+}
+
+void Application::wait_for_uploads() {
+    if (!uploads_in_flight) return;
+
+    wait_for_submission(upload_submission);
+    uploads_in_flight = false;
+
+    staging_ring.retire(upload_submission);
+    for (auto& [staging_buffer, staging_buffer_allocation] : upload_staging_buffers) {
+        vkDestroyBuffer(device, staging_buffer, nullptr);
+        allocator.free(staging_buffer_allocation);
+    }
+    upload_staging_buffers.clear();
+
+    vkResetCommandBuffer(upload_graphics_command_buffer, 0);
+    if (has_dedicated_transfer_queue()) {
+        vkResetCommandBuffer(upload_transfer_command_buffer, 0);
+    }
+}
+
+void Application::draw_frame() {
+    auto frame_start = std::chrono::steady_clock::now();
+    if (is_benchmark_recording() && frames_rendered > settings.benchmark_warmup_frames) {
+        benchmark.add_sample("frame", std::chrono::duration<double, std::milli>(frame_start - last_frame_start).count());
+    }
+    last_frame_start = frame_start;
+    auto stage_start = frame_start;
+
+    update_pipeline_variant();
+    update_asset_streaming();
+
+    wait_for_submission(frame_submissions[current_frame]);
+    profile_stage("frame_wait", stage_start);
+
+    // The descriptor set of this slot is no longer in use, so it can move to the streamed texture
+    if (asset_state == AssetState::ready && descriptor_texture_views[current_frame] != texture_image_view) {
+        update_texture_descriptor(current_frame);
+    }
+
+    // An upper bound, the frame may have completed before the wait started
+    if (is_benchmark_recording() && frame_submissions[current_frame] != 0) {
+        benchmark.add_sample("input_to_completion", std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - frame_input_times[current_frame]).count());
+    }
+    collect_gpu_timestamps(current_frame);
+
+    // Other frames may have completed in the meantime as well
+    uint64_t completed_submission = get_completed_submission();
+    staging_ring.retire(completed_submission);
+    destroy_retired_render_targets(completed_submission);
+
+    // Offscreen targets are owned per frame in flight, nothing to acquire
+    uint32_t image_index = current_frame;
+    if (!settings.headless) {
+        auto result = vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_index);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreate_swap_chain();
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("Failed to acquire swap chain image.");
+        }
+        profile_stage("acquire", stage_start);
+    }
 
     vkResetCommandBuffer(command_buffers[current_frame], 0);
     record_command_buffer(command_buffers[current_frame], image_index);
+    profile_stage("record_command_buffer", stage_start);
 
     update_uniform_buffer(current_frame);
+    profile_stage("update_uniform_buffer", stage_start);
+
+    // The value for the binary render finished semaphore is ignored
+    uint64_t submission = submission_count + 1;
+    std::array<uint64_t, 2> signal_values = {submission, 0};
+
+    VkTimelineSemaphoreSubmitInfo timeline_submit_info{};
+    timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_submit_info.signalSemaphoreValueCount = settings.headless ? 1 : 2;
+    timeline_submit_info.pSignalSemaphoreValues = signal_values.data();
 
     VkSubmitInfo submit_info{};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_submit_info;
 
     VkSemaphore wait_semaphores[] = {image_available_semaphores[current_frame]};
     VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = wait_semaphores;
-    submit_info.pWaitDstStageMask = wait_stages;
+    VkSemaphore signal_semaphores[] = {gpu_timeline, render_finished_semaphores[current_frame]};
+    if (!settings.headless) {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = wait_semaphores;
+        submit_info.pWaitDstStageMask = wait_stages;
+    }
+    submit_info.signalSemaphoreCount = settings.headless ? 1 : 2;
+    submit_info.pSignalSemaphores = signal_semaphores;
 
     submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &command_buffers[current_frame];
 
-    VkSemaphore signal_semaphores[] = {render_finished_semaphores[current_frame]};
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = signal_semaphores;
-
-    if (vkQueueSubmit(graphics_queue, 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
+    if (vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
         throw std::runtime_error("Failed to submit draw command buffer.");
     }
-    
-    VkPresentInfoKHR present_info{};
-    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = signal_semaphores;
+    frame_submissions[current_frame] = ++submission_count;
+    frame_input_times[current_frame] = input_time;
+    staging_ring.submit(submission_count);
+    profile_stage("submit", stage_start);
 
-    VkSwapchainKHR swap_chains[] = {swap_chain};
-    present_info.swapchainCount = 1;
-    present_info.pSwapchains = swap_chains;
-    present_info.pImageIndices = &image_index;
+    bool recorded_frame = is_benchmark_recording();
+    ++frames_rendered;
+    ++frames_since_report;
+    
+    if (!settings.headless) {
+        VkPresentInfoKHR present_info{};
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &render_finished_semaphores[current_frame];
+
+        VkSwapchainKHR swap_chains[] = {swap_chain};
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = swap_chains;
+        present_info.pImageIndices = &image_index;
+
+        auto result = vkQueuePresentKHR(present_queue, &present_info);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebuffer_resized) {
+            framebuffer_resized = false;
+            recreate_swap_chain();
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to present swap chain image.");
+        }
+        profile_stage("present", stage_start);
+    }
 
-    result = vkQueuePresentKHR(present_queue, &present_info);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebuffer_resized) {
-        framebuffer_resized = false;
-        recreate_swap_chain();
-    } else if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to present swap chain image.");
+    if (recorded_frame) {
+        auto now = std::chrono::steady_clock::now();
+        benchmark.add_sample("draw_frame", std::chrono::duration<double, std::milli>(now - frame_start).count());
+        benchmark.add_sample("input_to_present", std::chrono::duration<double, std::milli>(now - input_time).count());
     }
 
-    current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    current_frame = (current_frame + 1) % settings.frames_in_flight;
 }
 
 void Application::update_uniform_buffer(uint32_t _current_image) {
@@ -1517,5 +3720,153 @@ void Application::update_uniform_buffer(uint32_t _current_image) {
     ubo.projection = glm::perspective(glm::radians(60.0f), swap_chain_extent.width / (float) swap_chain_extent.height, 0.1f, 10.0f);
     ubo.projection[1][1] *= -1;
 
+    // Once per frame instead of in every culling invocation. The planes come from the rows of the
+    // combined matrix (Gribb and Hartmann), Vulkan clips z to [0, w]
+    glm::mat4 rows = glm::transpose(ubo.projection * ubo.view * ubo.model);
+    glm::vec4 planes[6] = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]};
+    for (int i = 0; i < 6; ++i) {
+        ubo.frustum_planes[i] = planes[i] / glm::length(glm::vec3(planes[i].x, planes[i].y, planes[i].z));
+    }
+    ubo.camera_position = glm::inverse(ubo.view * ubo.model)[3];
+
+    // Normalized device coordinates span 2 across the height of the viewport
+    ubo.lod_threshold = lod_pixel_error * 2.0f / swap_chain_extent.height;
+
     std::memcpy(uniform_buffers_pointers[_current_image], &ubo, sizeof(ubo));
-}
\ No newline at end of file
+}
+
+bool Application::is_benchmark_recording() {
+    return settings.benchmark_frames != 0 && frames_rendered >= settings.benchmark_warmup_frames;
+}
+
+void Application::profile_stage(const char* stage, std::chrono::steady_clock::time_point& stage_start) {
+    auto now = std::chrono::steady_clock::now();
+    if (is_benchmark_recording()) {
+        benchmark.add_sample(stage, std::chrono::duration<double, std::milli>(now - stage_start).count());
+    }
+    stage_start = now;
+}
+
+void Application::create_timestamp_query_pool() {
+    if (settings.benchmark_frames == 0) return;
+
+    uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+
+    auto graphics_family = find_queue_families(physical_device).graphics_family.value();
+    uint32_t valid_bits = queue_families[graphics_family].timestampValidBits;
+    if (valid_bits == 0) {
+        std::cout << "Graphics queue does not support timestamps, GPU times will not be reported.\n";
+        return;
+    }
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    timestamp_period = properties.limits.timestampPeriod;
+    timestamp_mask = (valid_bits >= 64) ? std::numeric_limits<uint64_t>::max() : ((uint64_t{1} << valid_bits) - 1);
+
+    // Two timestamps around the render pass for each frame in flight
+    VkQueryPoolCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    create_info.queryCount = 2 * settings.frames_in_flight;
+
+    if (vkCreateQueryPool(device, &create_info, nullptr, &timestamp_query_pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timestamp query pool.");
+    }
+
+    timestamps_pending.assign(settings.frames_in_flight, false);
+}
+
+void Application::collect_gpu_timestamps(uint32_t frame) {
+    if (timestamp_query_pool == VK_NULL_HANDLE || !timestamps_pending[frame]) return;
+    timestamps_pending[frame] = false;
+
+    // The frame has completed on the GPU, so the results are available without waiting
+    std::array<uint64_t, 2> timestamps{};
+    auto result = vkGetQueryPoolResults(device, timestamp_query_pool, 2 * frame, 2,
+                                        sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+                                        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) return;
+
+    uint64_t ticks = ((timestamps[1] & timestamp_mask) - (timestamps[0] & timestamp_mask)) & timestamp_mask;
+    benchmark.add_sample("gpu_render_pass", static_cast<double>(ticks) * timestamp_period / 1e6);
+}
+
+void Application::write_benchmark_report() {
+    for (uint32_t i = 0; i < settings.frames_in_flight; ++i) {
+        collect_gpu_timestamps(i);
+    }
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    auto frame_statistics = benchmark.get_statistics("frame");
+    auto gpu_statistics = benchmark.get_statistics("gpu_render_pass");
+
+    benchmark.set_property("commit", GIT_COMMIT);
+    benchmark.set_property("device", properties.deviceName);
+    benchmark.set_property("driver_version", static_cast<double>(properties.driverVersion));
+    benchmark.set_property("headless", settings.headless ? "true" : "false");
+    benchmark.set_property("width", static_cast<double>(swap_chain_extent.width));
+    benchmark.set_property("height", static_cast<double>(swap_chain_extent.height));
+    benchmark.set_property("msaa_samples", static_cast<double>(msaa_samples));
+    benchmark.set_property("dynamic_rendering", use_dynamic_rendering ? "true" : "false");
+    benchmark.set_property("frames_in_flight", static_cast<double>(settings.frames_in_flight));
+    benchmark.set_property("present_mode", settings.headless ? "none" : get_present_mode_name(present_mode));
+    benchmark.set_property("fps_limit", static_cast<double>(settings.fps_limit));
+    benchmark.set_property("pipeline_variant", describe_pipeline_key(pipeline_key));
+    benchmark.set_property("pipeline_variants_ready", static_cast<double>(pipeline_library.get_ready_count()));
+    benchmark.set_property("attachment_reallocations", static_cast<double>(attachment_reallocations));
+    benchmark.set_property("frames", static_cast<double>(settings.benchmark_frames));
+    benchmark.set_property("warmup_frames", static_cast<double>(settings.benchmark_warmup_frames));
+    benchmark.set_property("fps", frame_statistics.mean > 0.0 ? 1000.0 / frame_statistics.mean : 0.0);
+
+    auto memory_statistics = allocator.get_statistics();
+    benchmark.set_property("memory_blocks", static_cast<double>(memory_statistics.block_count));
+    benchmark.set_property("memory_reserved_bytes", static_cast<double>(memory_statistics.reserved_bytes));
+    benchmark.set_property("memory_used_bytes", static_cast<double>(memory_statistics.used_bytes));
+    benchmark.set_property("draw_count", static_cast<double>(settings.draw_count));
+    benchmark.set_property("instance_count", static_cast<double>(settings.instance_count));
+    benchmark.set_property("gpu_ms_per_draw", gpu_statistics.mean / settings.draw_count);
+    benchmark.set_property("gpu_culling", settings.gpu_culling ? "true" : "false");
+    benchmark.set_property("meshlets", static_cast<double>(meshlet_data.meshlets.size()));
+    benchmark.set_property("lod_count", static_cast<double>(lods.size()));
+    // The path that culled the last frames, the task shader only culls with cluster culling enabled
+    const char* culling = "none";
+    if (pipeline_key.mesh_shading) {
+        culling = (settings.gpu_culling && settings.cluster_culling) ? "task_shader" : "none";
+    } else if (settings.gpu_culling) {
+        culling = use_cluster_culling ? "cluster" : "instance";
+    }
+    benchmark.set_property("culling", culling);
+    benchmark.set_property("mesh_shading", pipeline_key.mesh_shading ? "true" : "false");
+    benchmark.set_property("record_threads", static_cast<double>(recording_slice_count));
+    benchmark.set_property("startup_ms", startup_milliseconds);
+    benchmark.set_property("pipeline_creation_ms", pipeline_creation_milliseconds);
+    benchmark.set_property("pipeline_cache", pipeline_cache_warm ? "warm" : "cold");
+    benchmark.set_property("mesh_cache_hit", mesh_cache_hit ? "true" : "false");
+    benchmark.set_property("model_load_ms", model_load_milliseconds);
+    benchmark.set_property("mesh_optimization", !settings.mesh_optimization ? "none" : settings.overdraw_sort ? "vertex_cache+overdraw" : "vertex_cache");
+    benchmark.set_property("mesh_acmr", mesh_statistics.acmr);
+    benchmark.set_property("vertex_layout", gpu_vertex_layout_name);
+    benchmark.set_property("index_type", index_type == VK_INDEX_TYPE_UINT16 ? "uint16" : "uint32");
+    benchmark.set_property("index_ranges", static_cast<double>(index_ranges.size()));
+    benchmark.set_property("vertex_stride", static_cast<double>(GpuVertexLayout::stride));
+    benchmark.set_property("mesh_atvr", mesh_statistics.atvr);
+    benchmark.set_property("texture_format", texture_format == VK_FORMAT_BC7_SRGB_BLOCK ? "BC7" : "RGBA8");
+    benchmark.set_property("texture_bytes", static_cast<double>(texture_bytes));
+    benchmark.set_property("texture_cache_hit", texture_cache_hit ? "true" : "false");
+    benchmark.set_property("texture_mipmaps", texture_mipmaps_on_cpu ? "cpu" : "gpu");
+    benchmark.set_property("texture_load_ms", texture_load_milliseconds);
+    benchmark.set_property("async_assets", settings.async_assets ? "true" : "false");
+    benchmark.set_property("assets_ready_ms", assets_ready_milliseconds);
+    benchmark.set_property("staging_ring_bytes", static_cast<double>(staging_ring.get_capacity()));
+    benchmark.set_property("staging_ring_peak_bytes", static_cast<double>(staging_ring.get_peak_used_bytes()));
+
+    benchmark.print_summary();
+    benchmark.write_json(settings.benchmark_output);
+    std::cout << "Benchmark results written to " << settings.benchmark_output << std::endl;
+}
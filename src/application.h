@@ -5,9 +5,29 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
+#include <string>
 #include <optional>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <future>
+
+#include "benchmark.h"
+#include "memory_allocator.h"
+#include "staging_ring.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "vertex_layout.h"
+#include "index_ranges.h"
+#include "meshlets.h"
+#include "mesh_simplifier.h"
+#include "texture_cache.h"
+#include "mip_builder.h"
+#include "thread_pool.h"
+#include "pipeline_library.h"
 
 struct Vertex;
+struct DrawPushConstants;
 
 const std::vector<const char*> requested_layers = {
     "VK_LAYER_KHRONOS_validation",
@@ -17,10 +37,95 @@ const std::vector<const char*> required_device_extensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 };
 
+struct Settings {
+    // Render into offscreen images instead of a window and swapchain
+    bool headless = false;
+    uint32_t width = 800;
+    uint32_t height = 600;
+
+    // Number of frames to render before exiting, 0 means until the window is closed
+    uint32_t frame_count = 0;
+
+    // Frames the CPU may record ahead of the GPU, from 1 to 4. More frames raise
+    // throughput when either side stalls, at the cost of input latency
+    uint32_t frames_in_flight = 2;
+
+    // Used when the surface supports it, FIFO otherwise
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+
+    // Frames started per second at most, 0 disables the limiter
+    uint32_t fps_limit = 0;
+
+    // Number of frames measured by the benchmark, 0 disables it
+    uint32_t benchmark_frames = 0;
+    uint32_t benchmark_warmup_frames = 60;
+    std::string benchmark_output = "benchmark.json";
+
+    // Load the deduplicated model from its binary cache instead of parsing the OBJ
+    bool mesh_cache = true;
+
+    // Reorder triangles and vertices of a freshly parsed model for the post-transform cache
+    // and vertex fetch, and sort clusters of triangles to reduce overdraw
+    bool mesh_optimization = true;
+    bool overdraw_sort = true;
+
+    // Store and draw indices as 16 bits, cutting meshes with more vertices than that addresses into ranges
+    bool index_16bit = true;
+
+    // Levels of detail of the model, the full mesh included. The culling pass and the task
+    // shader pick one per instance from its projected size, 1 always draws the full mesh
+    uint32_t lod_count = 4;
+
+    // Draw a placeholder while the model and the texture are loaded on the thread pool
+    bool async_assets = true;
+
+    // Upload the texture BC7 compressed from its transcoding cache when the device can sample BC7
+    bool texture_compression = true;
+
+    // Build the mip chain of an uncompressed texture on the CPU and cache it, instead of blitting it on the GPU
+    bool cpu_mipmaps = true;
+
+    // Number of copies of the model drawn each frame, laid out on a grid
+    uint32_t draw_count = 1;
+
+    // Instances rendered by every draw, laid out on a grid within the footprint of the draw
+    uint32_t instance_count = 1;
+
+    // Cull instances against the view frustum in a compute pass before drawing
+    bool gpu_culling = true;
+
+    // Cull the meshlets of every instance by the frustum and their normal cones instead of
+    // whole instances, where the device can draw a count of indirect commands written on the GPU
+    bool cluster_culling = true;
+
+    // Draw the model with task and mesh shaders when the device supports VK_EXT_mesh_shader
+    bool mesh_shading = true;
+
+    // Load compiled pipelines from disk at startup and store them again at shutdown
+    bool pipeline_cache = true;
+
+    // Pipeline variant used from the first frame, a sample count of 0 picks the highest one
+    uint32_t msaa_samples = 0;
+    bool wireframe = false;
+    bool depth_only = false;
+    bool blended = false;
+
+    // Render with VK_KHR_dynamic_rendering instead of render pass and framebuffer objects
+    // when the device supports it
+    bool dynamic_rendering = true;
+
+    // Threads recording secondary command buffers, 1 records inline into the primary
+    // command buffer and 0 uses every hardware thread
+    uint32_t record_threads = 0;
+};
+
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphics_family;
     std::optional<uint32_t> present_family;
 
+    // Queue family without graphics support, usually backed by a DMA engine
+    std::optional<uint32_t> transfer_family;
+
     bool is_complete() {
         return graphics_family.has_value() && present_family.has_value();
     }
@@ -32,9 +137,24 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> present_modes;
 };
 
+// Render targets replaced while frames that use them may still be in flight, destroyed
+// once the submission they were retired at has completed
+struct RetiredRenderTargets {
+    uint64_t submission = 0;
+    VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
+    std::vector<VkImageView> image_views;
+    std::vector<VkFramebuffer> framebuffers;
+    VkImage color_image = VK_NULL_HANDLE;
+    VkImageView color_image_view = VK_NULL_HANDLE;
+    Allocation color_image_allocation;
+    VkImage depth_image = VK_NULL_HANDLE;
+    VkImageView depth_image_view = VK_NULL_HANDLE;
+    Allocation depth_image_allocation;
+};
+
 class Application {
 public:
-    Application();
+    explicit Application(const Settings&);
 
     void run();
 
@@ -46,6 +166,8 @@ public:
     ~Application();
 
 private:
+    Settings settings;
+
     // Initializing glfw
     void init_glfw();
     GLFWwindow* window;
@@ -74,6 +196,9 @@ private:
     void select_physical_device();
     bool is_suitable_device(VkPhysicalDevice);
     bool check_device_extension_support(VkPhysicalDevice);
+    bool supports_dynamic_rendering(VkPhysicalDevice);
+    bool supports_mesh_shading(VkPhysicalDevice);
+    std::vector<const char*> get_required_device_extensions();
     void sort_physical_devices(std::vector<VkPhysicalDevice>&);
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
     
@@ -87,6 +212,9 @@ private:
     // Queues
     VkQueue graphics_queue;
     VkQueue present_queue;
+    VkQueue transfer_queue;
+    uint32_t graphics_queue_family;
+    uint32_t transfer_queue_family;
 
     // Swapchain queries
     SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice);
@@ -95,88 +223,267 @@ private:
     VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR&);
 
     // Swapchain
-    void create_swap_chain();
+    void create_swap_chain(VkSwapchainKHR old_swap_chain = VK_NULL_HANDLE);
     void recreate_swap_chain();
     void cleanup_swap_chain();
+    void cleanup_render_targets();
     VkFormat swap_chain_image_format;
     VkExtent2D swap_chain_extent;
     std::vector<VkImage> swap_chain_images;
     VkSwapchainKHR swap_chain;
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    bool present_mode_fallback_reported = false;
     bool framebuffer_resized = false;
 
+    // Retired render targets
+    // Recreation never waits for the device to go idle. Old resources are destroyed after the
+    // last frame that could use them has completed on the GPU, and attachments are only reallocated when
+    // the extent grows beyond render_target_extent
+    void retire_attachments(RetiredRenderTargets&);
+    void destroy_retired_render_targets(uint64_t completed_submission);
+    std::deque<RetiredRenderTargets> retired_render_targets;
+    VkExtent2D render_target_extent;
+    uint32_t attachment_reallocations = 0;
+
+    // Offscreen targets used in place of the swapchain when headless
+    void create_offscreen_targets();
+    std::vector<Allocation> offscreen_images_allocations;
+
     // Image views
     void create_image_views();
     std::vector<VkImageView> swap_chain_image_views;
 
     // Render pass
-    void create_render_pass();
+    // One per usable sample count, pipeline variants with that count are compiled against it.
+    // None are created with dynamic rendering, get_render_pass then returns VK_NULL_HANDLE
+    void create_render_passes();
+    VkRenderPass create_render_pass(VkSampleCountFlagBits);
+    VkRenderPass get_render_pass(VkSampleCountFlagBits);
+    std::vector<VkRenderPass> render_passes;
     VkRenderPass render_pass;
 
+    // Pipeline cache
+    void create_pipeline_cache();
+    void save_pipeline_cache();
+    VkPipelineCache pipeline_cache;
+    bool pipeline_cache_warm = false;
+    double pipeline_creation_milliseconds = 0.0;
+
     // Descriptor set layout
     void create_descriptor_set_layout();
     VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorSetLayout meshlet_descriptor_set_layout = VK_NULL_HANDLE;
 
     // Graphics pipeline
+    // graphics_pipeline is the variant drawn with, owned by the pipeline library like every other variant
     void create_graphics_pipeline();
-    VkShaderModule create_shader_module(const std::vector<char>&);
+    VkPipeline compile_graphics_pipeline(const PipelineKey&);
+    VkShaderModule create_shader_module(const std::string& path);
+    VkShaderModule vert_shader_module;
+    VkShaderModule frag_shader_module;
+    VkShaderModule task_shader_module = VK_NULL_HANDLE;
+    VkShaderModule mesh_shader_module = VK_NULL_HANDLE;
     VkPipelineLayout pipeline_layout;
+    VkShaderStageFlags push_constant_stages = VK_SHADER_STAGE_VERTEX_BIT;
     VkPipeline graphics_pipeline;
 
+    // Pipeline variants
+    // Every variant is compiled on the thread pool after startup. A requested variant replaces
+    // the current one only once it is ready, until then drawing continues with the current one
+    void request_pipeline_variants();
+    void update_pipeline_variant();
+    PipelineLibrary pipeline_library;
+    PipelineKey pipeline_key;
+    PipelineKey requested_pipeline_key;
+    bool fill_mode_non_solid = false;
+
     // Framebuffers
     void create_framebuffers();
     std::vector<VkFramebuffer> swap_chain_framebuffers;
 
+    // Dynamic rendering
+    // Attachments are passed to vkCmdBeginRenderingKHR directly, and the layout transitions
+    // the render pass used to do are recorded as barriers around the rendering scope
+    void begin_dynamic_rendering(VkCommandBuffer, uint32_t image_index, VkRenderingFlagsKHR);
+    void end_dynamic_rendering(VkCommandBuffer, uint32_t image_index);
+    bool use_dynamic_rendering = false;
+    PFN_vkCmdBeginRenderingKHR cmd_begin_rendering = nullptr;
+    PFN_vkCmdEndRenderingKHR cmd_end_rendering = nullptr;
+
+    // Asset streaming
+    // The model and the texture are read and decoded on the thread pool while frames draw a
+    // placeholder cube with a grey texture. Once decoding is done draw_frame submits their uploads,
+    // and once the GPU timeline passes that submission the real buffers are drawn instead. Each
+    // descriptor set moves to the streamed texture when its frame slot comes up again
+    enum class AssetState {
+        loading,
+        uploading,
+        ready,
+    };
+    void create_asset_resources();
+    void create_placeholder_assets();
+    void start_asset_streaming();
+    void update_asset_streaming();
+    void finish_asset_streaming();
+    AssetState asset_state = AssetState::loading;
+    std::future<void> asset_loading;
+    std::chrono::steady_clock::time_point asset_streaming_start;
+    double assets_ready_milliseconds = 0.0;
+    VkBuffer placeholder_vertex_buffer;
+    Allocation placeholder_vertex_buffer_allocation;
+    VkBuffer placeholder_index_buffer;
+    Allocation placeholder_index_buffer_allocation;
+    uint32_t placeholder_index_count = 0;
+    VertexQuantization placeholder_quantization;
+    VkImage placeholder_texture_image;
+    Allocation placeholder_texture_image_allocation;
+    VkImageView placeholder_texture_image_view;
+
     // Model data
     void load_model();
+    void parse_model(const MappedFile&);
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
 
+    // Point either into vertices and indices or into the mapped mesh cache
+    MeshCache mesh_cache;
+    const void* vertex_data = nullptr;
+    uint32_t vertex_count = 0;
+    const uint32_t* index_data = nullptr;
+    uint32_t index_count = 0;
+    bool mesh_cache_hit = false;
+    uint32_t get_mesh_cache_flags() const;
+
+    // Post-transform cache efficiency of the index buffer as drawn
+    VertexCacheStatistics mesh_statistics;
+
+    // Coarser levels of detail are simplified from the full mesh and appended behind it in
+    // lod_indices, which index_data and index_count then span. All of them share the vertices
+    void build_model_lods();
+    std::vector<uint32_t> lod_indices;
+    std::vector<MeshLod> lods;
+
+    // Every range is drawn with its own indirect command and belongs to a single level of detail.
+    // With 16-bit indices vertex_data and vertex_count point into split_vertices when the mesh
+    // had to be cut into several ranges
+    void build_index_ranges();
+    std::vector<IndexRange> index_ranges;
+    std::vector<uint16_t> narrow_indices;
+    std::vector<Vertex> split_vertices;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+
+    // Meshlets of the index buffer as drawn, culled per instance and drawn by the mesh shader.
+    // Those of a level of detail are consecutive, the full mesh usually has the most of them
+    void build_model_meshlets();
+    MeshletData meshlet_data;
+    uint32_t max_lod_meshlet_count = 0;
+
+    // Undoes the quantization of the vertex buffer, identity for the full layout
+    VertexQuantization model_quantization;
+
+    // Center in model space followed by the radius
+    void compute_bounding_sphere();
+    std::array<float, 4> bounding_sphere;
+    double model_load_milliseconds = 0.0;
+
+    // Mesh shading
+    // With VK_EXT_mesh_shader the streamed model is drawn by task and mesh shader variants of the
+    // pipeline. A task shader workgroup culls 32 meshlets of one instance and launches a mesh shader
+    // workgroup for every visible one, so neither the culling pass nor indirect buffers are needed.
+    // Set 1 holds the meshlets, the levels of detail and the vertex buffer as storage buffers
+    void create_meshlet_buffers();
+    void create_meshlet_descriptor_set();
+    void write_meshlet_descriptors();
+    bool use_mesh_shading = false;
+    PFN_vkCmdDrawMeshTasksEXT cmd_draw_mesh_tasks = nullptr;
+    VkPhysicalDeviceMeshShaderPropertiesEXT mesh_shader_properties{};
+    VkDescriptorSet meshlet_descriptor_set = VK_NULL_HANDLE;
+    VkBuffer meshlet_buffer = VK_NULL_HANDLE;
+    Allocation meshlet_buffer_allocation;
+    VkBuffer meshlet_vertex_buffer = VK_NULL_HANDLE;
+    Allocation meshlet_vertex_buffer_allocation;
+    VkBuffer meshlet_triangle_buffer = VK_NULL_HANDLE;
+    Allocation meshlet_triangle_buffer_allocation;
+
+    // The MeshLod table, read by the culling pass and the task shader
+    void create_lod_buffer();
+    VkBuffer lod_buffer = VK_NULL_HANDLE;
+    Allocation lod_buffer_allocation;
+
+    // Device memory
+    MemoryAllocator allocator;
+
     // Buffers
-    uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags);
-    void create_buffer(VkDeviceSize, VkBufferUsageFlags, VkMemoryPropertyFlags, VkBuffer&, VkDeviceMemory&);
-    void copy_buffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize);
+    void create_buffer(VkDeviceSize, VkBufferUsageFlags, VkMemoryPropertyFlags, VkBuffer&, Allocation&);
+    void copy_buffer(VkCommandBuffer, VkBuffer src_buffer, VkDeviceSize src_offset, VkBuffer dst_buffer, VkDeviceSize);
     void create_vertex_buffer();
     void create_index_buffer();
     void create_uniform_buffers();
-    VkBuffer vertex_buffer;
-    VkDeviceMemory vertex_buffer_memory;
-    VkBuffer index_buffer;
-    VkDeviceMemory index_buffer_memory;
+    void create_instance_buffer();
+    void create_indirect_buffer();
+    VkBuffer vertex_buffer = VK_NULL_HANDLE;
+    Allocation vertex_buffer_allocation;
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+    Allocation index_buffer_allocation;
+    VkBuffer instance_buffer;
+    Allocation instance_buffer_allocation;
+    VkBuffer indirect_buffer = VK_NULL_HANDLE;
+    Allocation indirect_buffer_allocation;
     std::vector<VkBuffer> uniform_buffers;
-    std::vector<VkDeviceMemory> uniform_buffers_memory;
+    std::vector<Allocation> uniform_buffers_allocations;
     std::vector<void*> uniform_buffers_pointers;
 
     // Texture image
     void create_image(uint32_t width, uint32_t height, uint32_t _mip_levels, VkSampleCountFlagBits nr_samples,
                      VkFormat, VkImageTiling, VkImageUsageFlags, 
-                     VkMemoryPropertyFlags, VkImage&, VkDeviceMemory&);
+                     VkMemoryPropertyFlags, VkImage&, Allocation&);
     VkImageView create_image_view(VkImage, VkFormat, VkImageAspectFlags, uint32_t _mip_levels);
-    void transition_image_layout(VkImage, VkFormat, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t _mip_levels);
-    void generate_mipmaps(VkImage, VkFormat, int32_t texture_width, int32_t texture_height, uint32_t _mip_levels);
+    void transition_image_layout(VkCommandBuffer, VkImage, VkFormat, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t _mip_levels);
+    void generate_mipmaps(VkCommandBuffer, VkImage, VkFormat, int32_t texture_width, int32_t texture_height, uint32_t _mip_levels);
+    void choose_texture_format();
+    MipLevel decode_texture_file(const MappedFile&);
+    void load_texture();
+    void load_cached_texture_levels(TextureCacheFormat);
     void create_texture_image();
     void create_texture_image_view();
     void create_texture_sampler();
-    void copy_buffer_to_image(VkBuffer, VkImage, uint32_t width, uint32_t height);
-    VkImage texture_image;
+    void copy_buffer_to_image(VkCommandBuffer, VkBuffer, VkDeviceSize buffer_offset, VkImage, uint32_t width, uint32_t height,
+                              uint32_t mip_level = 0);
+    VkImage texture_image = VK_NULL_HANDLE;
+    VkFormat texture_format = VK_FORMAT_R8G8B8A8_SRGB;
     uint32_t mip_levels;
-    VkDeviceMemory texture_image_memory;
-    VkImageView texture_image_view;
+    Allocation texture_image_allocation;
+    VkImageView texture_image_view = VK_NULL_HANDLE;
     VkSampler texture_sampler;
+    VkDeviceSize texture_bytes = 0;
+    bool texture_cache_hit = false;
+    bool texture_mipmaps_on_cpu = false;
+    double texture_load_milliseconds = 0.0;
+
+    // Decoded texture waiting for create_texture_image, levels point into the mapped cache,
+    // texture_mip_chain or texture_encoded_levels
+    TextureCache texture_cache;
+    std::vector<TextureLevel> texture_levels;
+    std::vector<MipLevel> texture_mip_chain;
+    std::vector<std::vector<uint8_t>> texture_encoded_levels;
 
     // Multisampling
     VkSampleCountFlagBits get_max_usable_sample_count();
+    std::vector<VkSampleCountFlagBits> get_usable_sample_counts();
+    std::vector<VkSampleCountFlagBits> usable_sample_counts;
     void create_color_resource();
     VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
     VkImage color_image;
-    VkDeviceMemory color_image_memory;
+    Allocation color_image_allocation;
     VkImageView color_image_view;
 
     // Depth buffer
     void create_depth_resource();
+    bool is_format_supported(VkFormat, VkImageTiling, VkFormatFeatureFlags);
     VkFormat find_supported_format(const std::vector<VkFormat>&, VkImageTiling, VkFormatFeatureFlags);
     VkFormat find_depth_format();
     VkImage depth_image;
-    VkDeviceMemory depth_image_memory;
+    Allocation depth_image_allocation;
     VkImageView depth_image_view;
 
     // Decriptor pool
@@ -185,7 +492,9 @@ private:
 
     // Descriptor sets
     void create_descriptor_sets();
+    void update_texture_descriptor(size_t frame);
     std::vector<VkDescriptorSet> descriptor_sets;
+    std::vector<VkImageView> descriptor_texture_views;
 
     // Command pool
     void create_command_pool();
@@ -194,21 +503,135 @@ private:
     // Command buffer
     void create_command_buffers();
     void record_command_buffer(VkCommandBuffer, uint32_t image_index);
-    VkCommandBuffer begin_single_time_commands();
-    void end_single_time_commands(VkCommandBuffer);
+    void record_draws(VkCommandBuffer, size_t first_draw, size_t end_draw);
     std::vector<VkCommandBuffer> command_buffers;
 
+    // Draws
+    void create_draw_push_constants();
+    std::vector<DrawPushConstants> draw_push_constants;
+
+    // GPU culling
+    // Tests every instance of every draw against the view frustum in a compute pass and
+    // compacts the visible ones into per frame instance and indirect buffers, with a separate
+    // run of instances for every level of detail. With cluster culling it tests every meshlet
+    // of the level of every instance instead, and writes one command per visible meshlet and a
+    // count per draw for vkCmdDrawIndexedIndirectCount. Mesh shading culls in the task shader
+    // instead, the pass then only culls instances for frames drawn with the vertex pipeline
+    void create_cull_descriptor_set_layout();
+    void create_cull_pipeline();
+    void create_cluster_cull_pipeline();
+    void create_cull_buffers();
+    void create_culled_indirect_buffers();
+    void create_cull_descriptor_sets();
+    void write_culled_indirect_descriptors();
+    void record_culling(VkCommandBuffer);
+    VkDescriptorSetLayout cull_descriptor_set_layout;
+    VkPipelineLayout cull_pipeline_layout;
+    VkPipeline cull_pipeline;
+    VkPipeline cluster_cull_pipeline = VK_NULL_HANDLE;
+    bool use_cluster_culling = false;
+    VkBuffer draw_placement_buffer;
+    Allocation draw_placement_buffer_allocation;
+    std::vector<VkBuffer> visible_instance_buffers;
+    std::vector<Allocation> visible_instance_buffers_allocations;
+    std::vector<VkBuffer> culled_indirect_buffers;
+    std::vector<Allocation> culled_indirect_buffers_allocations;
+    VkBuffer cull_command_template_buffer = VK_NULL_HANDLE;
+    Allocation cull_command_template_buffer_allocation;
+    std::vector<VkBuffer> cull_count_buffers;
+    std::vector<Allocation> cull_count_buffers_allocations;
+    std::vector<VkDescriptorSet> cull_descriptor_sets;
+
+    // Parallel recording
+    // Draws are split into slices recorded into secondary command buffers on the thread pool.
+    // Each slice has its own command pool per frame in flight, reset as a whole every frame
+    void create_recording_command_pools();
+    void record_secondary_command_buffers(uint32_t image_index);
+    ThreadPool thread_pool;
+    uint32_t recording_slice_count = 1;
+    std::vector<VkCommandPool> recording_command_pools;
+    std::vector<VkCommandBuffer> secondary_command_buffers;
+
+    // Uploads
+    // Copies are recorded on the transfer queue, mipmap blits and queue family
+    // ownership acquires on the graphics queue, and the whole batch is submitted at once
+    void create_upload_context();
+    void begin_uploads();
+    void upload_buffer(const void* data, VkDeviceSize, VkBuffer dst_buffer, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+    void upload_vertices(const Vertex* vertices, uint32_t vertex_count, const VertexQuantization&, VkBuffer dst_buffer);
+    void upload_image(const void* data, VkDeviceSize, VkImage, VkFormat, uint32_t width, uint32_t height, uint32_t _mip_levels);
+    void upload_image_levels(const std::vector<TextureLevel>&, VkImage, VkFormat);
+    void submit_uploads();
+    void wait_for_uploads();
+    bool has_dedicated_transfer_queue();
+    StagingRegion stage_upload_data(const void* data, VkDeviceSize);
+    VkCommandPool transfer_command_pool;
+    VkCommandBuffer upload_transfer_command_buffer;
+    VkCommandBuffer upload_graphics_command_buffer;
+    std::vector<std::pair<VkBuffer, Allocation>> upload_staging_buffers;
+    bool uploads_in_flight = false;
+    uint64_t upload_submission = 0;
+
+    // Staging ring
+    // Shared by every upload, regions are reclaimed once the submission reading them has retired
+    StagingRing staging_ring;
+
+    // GPU progress
+    // Every graphics queue submission signals gpu_timeline with its submission id, so the counter
+    // value is the id of the last completed submission and anything tagged with an id can be waited
+    // on or reclaimed without fences. The transfer queue counts its own submissions on transfer_timeline
+    void create_timeline_semaphores();
+    void wait_for_submission(uint64_t submission);
+    uint64_t get_completed_submission();
+    VkSemaphore gpu_timeline;
+    VkSemaphore transfer_timeline;
+    uint64_t submission_count = 0;
+    uint64_t transfer_submission_count = 0;
+    std::vector<uint64_t> frame_submissions;
+
     // Synchronization objects
     void create_sync_objects();
     std::vector<VkSemaphore> image_available_semaphores;
     std::vector<VkSemaphore> render_finished_semaphores;
-    std::vector<VkFence> in_flight_fences;
+
+    // Frame pacing
+    // The limiter sleeps before input is polled rather than after the frame, so a frame always
+    // starts from the freshest input. Latency is measured from that poll to the return of
+    // vkQueuePresentKHR, and to the timeline wait that observes the frame completed on the GPU
+    void pace_frame();
+    std::chrono::steady_clock::time_point next_frame_time;
+    std::chrono::steady_clock::time_point input_time;
+    std::vector<std::chrono::steady_clock::time_point> frame_input_times;
 
     // Drawing
+    bool should_close();
     void draw_frame();
     void update_uniform_buffer(uint32_t);
     uint32_t current_frame = 0;
     float time;
+
+    // Frame rate reporting
+    void report_frame_rate(bool final_report);
+    uint64_t frames_rendered = 0;
+    uint64_t frames_since_report = 0;
+    std::chrono::steady_clock::time_point run_start_time;
+    std::chrono::steady_clock::time_point last_report_time;
+
+    // Startup time of init_vulkan, reported for cold and warm pipeline caches
+    double startup_milliseconds = 0.0;
+
+    // Benchmark
+    bool is_benchmark_recording();
+    void profile_stage(const char* stage, std::chrono::steady_clock::time_point& stage_start);
+    void create_timestamp_query_pool();
+    void collect_gpu_timestamps(uint32_t frame);
+    void write_benchmark_report();
+    Benchmark benchmark;
+    std::chrono::steady_clock::time_point last_frame_start;
+    VkQueryPool timestamp_query_pool = VK_NULL_HANDLE;
+    float timestamp_period = 0.0f;
+    uint64_t timestamp_mask = 0;
+    std::vector<bool> timestamps_pending;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "bc7_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Interpolation weights of 4-bit indices out of 64, from the BC7 specification
+constexpr uint32_t bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Endpoints {
+    uint32_t values[2][4];
+    uint32_t p_bits[2];
+};
+
+uint64_t get_bc7_size(uint32_t width, uint32_t height) {
+    return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * bc7_block_bytes;
+}
+
+// Picks the 7-bit values and shared low bit that reproduce the endpoint most closely
+void quantize_endpoint(const float endpoint[4], uint32_t values[4], uint32_t& p_bit) {
+    float best_error = INFINITY;
+    for (uint32_t p = 0; p < 2; ++p) {
+        uint32_t candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; ++c) {
+            float q = std::round((endpoint[c] - static_cast<float>(p)) / 2.0f);
+            candidate[c] = static_cast<uint32_t>(std::clamp(q, 0.0f, 127.0f));
+            float difference = static_cast<float>((candidate[c] << 1) | p) - endpoint[c];
+            error += difference * difference;
+        }
+        if (error < best_error) {
+            best_error = error;
+            std::memcpy(values, candidate, sizeof(candidate));
+            p_bit = p;
+        }
+    }
+}
+
+// Chooses the closest palette entry for every texel, returns the total squared error
+uint32_t find_indices(const uint8_t texels[64], const Bc7Endpoints& endpoints, uint32_t indices[16]) {
+    uint32_t palette[16][4];
+    for (int c = 0; c < 4; ++c) {
+        uint32_t e0 = (endpoints.values[0][c] << 1) | endpoints.p_bits[0];
+        uint32_t e1 = (endpoints.values[1][c] << 1) | endpoints.p_bits[1];
+        for (int i = 0; i < 16; ++i) {
+            palette[i][c] = ((64 - bc7_weights[i]) * e0 + bc7_weights[i] * e1 + 32) >> 6;
+        }
+    }
+
+    uint32_t total_error = 0;
+    for (int t = 0; t < 16; ++t) {
+        uint32_t best_error = UINT32_MAX;
+        for (uint32_t i = 0; i < 16; ++i) {
+            uint32_t error = 0;
+            for (int c = 0; c < 4; ++c) {
+                int difference = static_cast<int>(palette[i][c]) - texels[t * 4 + c];
+                error += static_cast<uint32_t>(difference * difference);
+            }
+            if (error < best_error) {
+                best_error = error;
+                indices[t] = i;
+            }
+        }
+        total_error += best_error;
+    }
+    return total_error;
+}
+
+// Least squares endpoints for the given indices, false if every texel uses the same weight
+bool fit_endpoints(const uint8_t texels[64], const uint32_t indices[16], float endpoints[2][4]) {
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float d0[4] = {}, d1[4] = {};
+    for (int t = 0; t < 16; ++t) {
+        float w = bc7_weights[indices[t]] / 64.0f;
+        a += (1.0f - w) * (1.0f - w);
+        b += (1.0f - w) * w;
+        c += w * w;
+        for (int k = 0; k < 4; ++k) {
+            d0[k] += (1.0f - w) * texels[t * 4 + k];
+            d1[k] += w * texels[t * 4 + k];
+        }
+    }
+
+    float determinant = a * c - b * b;
+    if (std::abs(determinant) < 1e-6f) return false;
+
+    for (int k = 0; k < 4; ++k) {
+        endpoints[0][k] = std::clamp((c * d0[k] - b * d1[k]) / determinant, 0.0f, 255.0f);
+        endpoints[1][k] = std::clamp((a * d1[k] - b * d0[k]) / determinant, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+void write_bits(uint8_t block[bc7_block_bytes], uint32_t& position, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i, ++position) {
+        if (value & (1u << i)) {
+            block[position / 8] |= static_cast<uint8_t>(1u << (position % 8));
+        }
+    }
+}
+
+void encode_bc7_block(const uint8_t texels[64], uint8_t block[bc7_block_bytes]) {
+    // Endpoints start at the extremes of the texels along their principal axis
+    float mean[4] = {};
+    for (int t = 0; t < 16; ++t) {
+        for (int k = 0; k < 4; ++k) mean[k] += texels[t * 4 + k] / 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (int t = 0; t < 16; ++t) {
+        float d[4];
+        for (int k = 0; k < 4; ++k) d[k] = texels[t * 4 + k] - mean[k];
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) covariance[i][j] += d[i] * d[j];
+        }
+    }
+
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) next[i] += covariance[i][j] * axis[j];
+        }
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if (length < 1e-6f) break;
+        for (int k = 0; k < 4; ++k) axis[k] = next[k] / length;
+    }
+
+    float min_t = INFINITY, max_t = -INFINITY;
+    for (int t = 0; t < 16; ++t) {
+        float projection = 0.0f;
+        for (int k = 0; k < 4; ++k) projection += (texels[t * 4 + k] - mean[k]) * axis[k];
+        min_t = std::min(min_t, projection);
+        max_t = std::max(max_t, projection);
+    }
+
+    float endpoints[2][4];
+    for (int k = 0; k < 4; ++k) {
+        endpoints[0][k] = std::clamp(mean[k] + min_t * axis[k], 0.0f, 255.0f);
+        endpoints[1][k] = std::clamp(mean[k] + max_t * axis[k], 0.0f, 255.0f);
+    }
+
+    Bc7Endpoints quantized;
+    uint32_t indices[16];
+    quantize_endpoint(endpoints[0], quantized.values[0], quantized.p_bits[0]);
+    quantize_endpoint(endpoints[1], quantized.values[1], quantized.p_bits[1]);
+    uint32_t error = find_indices(texels, quantized, indices);
+
+    // A few rounds of refitting the endpoints to the chosen indices, kept only while they help
+    for (int iteration = 0; iteration < 2 && error > 0; ++iteration) {
+        if (!fit_endpoints(texels, indices, endpoints)) break;
+
+        Bc7Endpoints refined;
+        uint32_t refined_indices[16];
+        quantize_endpoint(endpoints[0], refined.values[0], refined.p_bits[0]);
+        quantize_endpoint(endpoints[1], refined.values[1], refined.p_bits[1]);
+        uint32_t refined_error = find_indices(texels, refined, refined_indices);
+        if (refined_error >= error) break;
+
+        error = refined_error;
+        quantized = refined;
+        std::memcpy(indices, refined_indices, sizeof(indices));
+    }
+
+    // The first index is stored without its top bit, which therefore has to be zero
+    if (indices[0] & 8) {
+        std::swap(quantized.values[0], quantized.values[1]);
+        std::swap(quantized.p_bits[0], quantized.p_bits[1]);
+        for (auto& index : indices) index = 15 - index;
+    }
+
+    std::memset(block, 0, bc7_block_bytes);
+    uint32_t position = 0;
+    write_bits(block, position, 1u << 6, 7);
+    for (int k = 0; k < 4; ++k) {
+        write_bits(block, position, quantized.values[0][k], 7);
+        write_bits(block, position, quantized.values[1][k], 7);
+    }
+    write_bits(block, position, quantized.p_bits[0], 1);
+    write_bits(block, position, quantized.p_bits[1], 1);
+    write_bits(block, position, indices[0], 3);
+    for (int t = 1; t < 16; ++t) {
+        write_bits(block, position, indices[t], 4);
+    }
+}
+
+void encode_bc7_rows(const uint8_t* pixels, uint32_t width, uint32_t height,
+                     uint32_t first_row, uint32_t end_row, uint8_t* blocks) {
+    uint32_t blocks_per_row = (width + 3) / 4;
+    for (uint32_t block_y = first_row; block_y < end_row; ++block_y) {
+        for (uint32_t block_x = 0; block_x < blocks_per_row; ++block_x) {
+            uint8_t texels[64];
+            for (uint32_t y = 0; y < 4; ++y) {
+                uint32_t source_y = std::min(block_y * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; ++x) {
+                    uint32_t source_x = std::min(block_x * 4 + x, width - 1);
+                    std::memcpy(&texels[(y * 4 + x) * 4], &pixels[(static_cast<size_t>(source_y) * width + source_x) * 4], 4);
+                }
+            }
+
+            size_t block_index = static_cast<size_t>(block_y) * blocks_per_row + block_x;
+            encode_bc7_block(texels, &blocks[block_index * bc7_block_bytes]);
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef BC7_ENCODER_H_INCLUDED
+#define BC7_ENCODER_H_INCLUDED
+
+#include <cstdint>
+
+constexpr uint32_t bc7_block_bytes = 16;
+
+// Bytes of a BC7 image, partial blocks at the right and bottom edges count as whole ones
+uint64_t get_bc7_size(uint32_t width, uint32_t height);
+
+// Encodes 4x4 RGBA8 texels given in row order as a single BC7 mode 6 block: one subset with
+// RGBA endpoints of 7 bits plus a shared low bit each and 4-bit indices. Works on the stored
+// values, so sRGB input stays sRGB encoded
+void encode_bc7_block(const uint8_t texels[64], uint8_t block[bc7_block_bytes]);
+
+// Encodes the block rows [first_row, end_row) of an RGBA8 image into blocks, which points at
+// the first block of the whole image. Texels past the edges repeat the last row or column
+void encode_bc7_rows(const uint8_t* pixels, uint32_t width, uint32_t height,
+                     uint32_t first_row, uint32_t end_row, uint8_t* blocks);
+
+#endif
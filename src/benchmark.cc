@@ -0,0 +1,140 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <stdexcept>
+
+std::string escape_json_string(const std::string& str) {
+    std::string escaped;
+    escaped.reserve(str.size() + 2);
+    escaped += '"';
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        } else {
+            escaped += c;
+        }
+    }
+    escaped += '"';
+    return escaped;
+}
+
+double percentile(const std::vector<double>& sorted_samples, double p) {
+    // Nearest-rank percentile
+    auto rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted_samples.size()));
+    rank = std::clamp<size_t>(rank, 1, sorted_samples.size());
+    return sorted_samples[rank - 1];
+}
+
+std::vector<double>* Benchmark::find_stage(const std::string& stage) {
+    auto it = std::find_if(stages.begin(), stages.end(), [&] (const auto& entry) {
+        return entry.first == stage;
+    });
+    return (it != stages.end()) ? &it->second : nullptr;
+}
+
+const std::vector<double>* Benchmark::find_stage(const std::string& stage) const {
+    auto it = std::find_if(stages.begin(), stages.end(), [&] (const auto& entry) {
+        return entry.first == stage;
+    });
+    return (it != stages.end()) ? &it->second : nullptr;
+}
+
+void Benchmark::add_sample(const std::string& stage, double milliseconds) {
+    auto samples = find_stage(stage);
+    if (samples == nullptr) {
+        stages.emplace_back(stage, std::vector<double>{});
+        samples = &stages.back().second;
+    }
+    samples->push_back(milliseconds);
+}
+
+StageStatistics Benchmark::get_statistics(const std::string& stage) const {
+    StageStatistics statistics;
+
+    auto samples = find_stage(stage);
+    if (samples == nullptr || samples->empty()) {
+        return statistics;
+    }
+
+    std::vector<double> sorted_samples = *samples;
+    std::sort(sorted_samples.begin(), sorted_samples.end());
+
+    statistics.sample_count = sorted_samples.size();
+    statistics.mean = std::accumulate(sorted_samples.begin(), sorted_samples.end(), 0.0) / sorted_samples.size();
+    statistics.min = sorted_samples.front();
+    statistics.p50 = percentile(sorted_samples, 50.0);
+    statistics.p95 = percentile(sorted_samples, 95.0);
+    statistics.p99 = percentile(sorted_samples, 99.0);
+    statistics.max = sorted_samples.back();
+
+    return statistics;
+}
+
+void Benchmark::set_property(const std::string& key, const std::string& value) {
+    properties.emplace_back(key, escape_json_string(value));
+}
+
+void Benchmark::set_property(const std::string& key, double value) {
+    std::ostringstream stream;
+    stream << std::setprecision(10) << value;
+    properties.emplace_back(key, stream.str());
+}
+
+void Benchmark::print_summary() const {
+    std::cout << "Benchmark results (ms):\n";
+    std::cout << '\t' << std::left << std::setw(24) << "stage" << std::right
+              << std::setw(10) << "mean" << std::setw(10) << "p50"
+              << std::setw(10) << "p95" << std::setw(10) << "p99" << '\n';
+
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto& [stage, samples] : stages) {
+        auto statistics = get_statistics(stage);
+        std::cout << '\t' << std::left << std::setw(24) << stage << std::right
+                  << std::setw(10) << statistics.mean << std::setw(10) << statistics.p50
+                  << std::setw(10) << statistics.p95 << std::setw(10) << statistics.p99 << '\n';
+    }
+    std::cout << std::endl;
+}
+
+void Benchmark::write_json(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open: " + path);
+    }
+
+    file << std::setprecision(6) << std::fixed;
+    file << "{\n";
+
+    file << "  \"properties\": {";
+    for (size_t i = 0; i < properties.size(); ++i) {
+        file << (i == 0 ? "\n" : ",\n");
+        file << "    " << escape_json_string(properties[i].first) << ": " << properties[i].second;
+    }
+    file << "\n  },\n";
+
+    file << "  \"stages\": {";
+    for (size_t i = 0; i < stages.size(); ++i) {
+        auto statistics = get_statistics(stages[i].first);
+        file << (i == 0 ? "\n" : ",\n");
+        file << "    " << escape_json_string(stages[i].first) << ": {"
+             << "\"samples\": " << statistics.sample_count << ", "
+             << "\"mean_ms\": " << statistics.mean << ", "
+             << "\"min_ms\": " << statistics.min << ", "
+             << "\"p50_ms\": " << statistics.p50 << ", "
+             << "\"p95_ms\": " << statistics.p95 << ", "
+             << "\"p99_ms\": " << statistics.p99 << ", "
+             << "\"max_ms\": " << statistics.max << "}";
+    }
+    file << "\n  }\n";
+
+    file << "}\n";
+}
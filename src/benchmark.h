@@ -0,0 +1,40 @@
+#ifndef BENCHMARK_H_INCLUDED
+#define BENCHMARK_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <utility>
+
+struct StageStatistics {
+    size_t sample_count = 0;
+    double mean = 0.0;
+    double min = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Collects per-stage timings in milliseconds and reports them as JSON
+class Benchmark {
+public:
+    void add_sample(const std::string& stage, double milliseconds);
+    StageStatistics get_statistics(const std::string& stage) const;
+
+    // Values are written as-is into the "properties" object of the report
+    void set_property(const std::string& key, const std::string& value);
+    void set_property(const std::string& key, double value);
+
+    void print_summary() const;
+    void write_json(const std::string& path) const;
+
+private:
+    std::vector<double>* find_stage(const std::string& stage);
+    const std::vector<double>* find_stage(const std::string& stage) const;
+
+    // Kept in insertion order so reports list stages in pipeline order
+    std::vector<std::pair<std::string, std::vector<double>>> stages;
+    std::vector<std::pair<std::string, std::string>> properties;
+};
+
+#endif
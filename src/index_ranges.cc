@@ -0,0 +1,53 @@
+#include "index_ranges.h"
+
+#include <limits>
+
+std::vector<IndexRange> build_16bit_index_ranges(const Vertex* vertices, uint32_t vertex_count,
+                                                 const uint32_t* indices, uint32_t index_count,
+                                                 std::vector<uint16_t>& narrow_indices, std::vector<Vertex>& split_vertices) {
+    narrow_indices.resize(index_count);
+    split_vertices.clear();
+
+    if (vertex_count <= max_range_vertex_count) {
+        for (uint32_t i = 0; i < index_count; ++i) {
+            narrow_indices[i] = static_cast<uint16_t>(indices[i]);
+        }
+        return {{0, index_count, 0}};
+    }
+
+    constexpr uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> local_indices(vertex_count, unmapped);
+    std::vector<uint32_t> range_vertices;
+    range_vertices.reserve(max_range_vertex_count);
+
+    std::vector<IndexRange> ranges;
+    ranges.push_back({0, 0, 0});
+    for (uint32_t first = 0; first + 3 <= index_count; first += 3) {
+        // Counts a vertex repeated within the triangle twice, which at worst closes a range early
+        uint32_t new_vertex_count = 0;
+        for (uint32_t i = first; i < first + 3; ++i) {
+            new_vertex_count += (local_indices[indices[i]] == unmapped);
+        }
+
+        if (range_vertices.size() + new_vertex_count > max_range_vertex_count) {
+            for (uint32_t vertex : range_vertices) {
+                local_indices[vertex] = unmapped;
+            }
+            range_vertices.clear();
+            ranges.push_back({first, 0, static_cast<int32_t>(split_vertices.size())});
+        }
+
+        for (uint32_t i = first; i < first + 3; ++i) {
+            uint32_t vertex = indices[i];
+            if (local_indices[vertex] == unmapped) {
+                local_indices[vertex] = static_cast<uint32_t>(range_vertices.size());
+                range_vertices.push_back(vertex);
+                split_vertices.push_back(vertices[vertex]);
+            }
+            narrow_indices[i] = static_cast<uint16_t>(local_indices[vertex]);
+        }
+        ranges.back().index_count += 3;
+    }
+
+    return ranges;
+}
@@ -0,0 +1,27 @@
+#ifndef INDEX_RANGES_H_INCLUDED
+#define INDEX_RANGES_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+
+#include "vertex.h"
+
+// Consecutive indices drawn with one vertex offset, one indirect command each
+struct IndexRange {
+    uint32_t first_index;
+    uint32_t index_count;
+    int32_t vertex_offset;
+};
+
+// Vertices a range of 16-bit indices can address, primitive restart is never enabled
+constexpr uint32_t max_range_vertex_count = 1u << 16;
+
+// Narrows indices to 16 bits relative to the vertex offset of their range. A mesh that fits
+// is a single range over its own vertices and split_vertices stays empty. A larger one is cut
+// into ranges of consecutive triangles, and the vertices of every range are copied into
+// split_vertices in order of first use, duplicating the ones shared across a cut
+std::vector<IndexRange> build_16bit_index_ranges(const Vertex* vertices, uint32_t vertex_count,
+                                                 const uint32_t* indices, uint32_t index_count,
+                                                 std::vector<uint16_t>& narrow_indices, std::vector<Vertex>& split_vertices);
+
+#endif
@@ -1,12 +1,119 @@
 #include <iostream>
 #include <cstdlib>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
 
 #include "application.h"
 
-int main() {
-    Application app;
+constexpr uint32_t default_headless_frame_count = 1000;
 
+VkPresentModeKHR parse_present_mode(const std::string& name) {
+    if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    if (name == "mailbox") return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+    if (name == "fifo-relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    throw std::runtime_error("Unknown present mode: " + name);
+}
+
+Settings parse_settings(int argc, char* argv[]) {
+    Settings settings;
+    bool frame_count_set = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next_value = [&] () -> uint32_t {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg + ".");
+            }
+            return static_cast<uint32_t>(std::stoul(argv[++i]));
+        };
+        auto next_string = [&] () -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg + ".");
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--headless") {
+            settings.headless = true;
+        } else if (arg == "--width") {
+            settings.width = next_value();
+        } else if (arg == "--height") {
+            settings.height = next_value();
+        } else if (arg == "--frames") {
+            settings.frame_count = next_value();
+            frame_count_set = true;
+        } else if (arg == "--frames-in-flight") {
+            settings.frames_in_flight = std::clamp(next_value(), 1u, 4u);
+        } else if (arg == "--present-mode") {
+            settings.present_mode = parse_present_mode(next_string());
+        } else if (arg == "--fps-limit") {
+            settings.fps_limit = next_value();
+        } else if (arg == "--no-mesh-cache") {
+            settings.mesh_cache = false;
+        } else if (arg == "--no-mesh-optimization") {
+            settings.mesh_optimization = false;
+        } else if (arg == "--no-overdraw-sort") {
+            settings.overdraw_sort = false;
+        } else if (arg == "--32-bit-indices") {
+            settings.index_16bit = false;
+        } else if (arg == "--lods") {
+            settings.lod_count = std::max(1u, next_value());
+        } else if (arg == "--sync-assets") {
+            settings.async_assets = false;
+        } else if (arg == "--no-texture-compression") {
+            settings.texture_compression = false;
+        } else if (arg == "--gpu-mipmaps") {
+            settings.cpu_mipmaps = false;
+        } else if (arg == "--draw-count") {
+            settings.draw_count = std::max(1u, next_value());
+        } else if (arg == "--instances") {
+            settings.instance_count = std::max(1u, next_value());
+        } else if (arg == "--no-pipeline-cache") {
+            settings.pipeline_cache = false;
+        } else if (arg == "--no-culling") {
+            settings.gpu_culling = false;
+        } else if (arg == "--no-cluster-culling") {
+            settings.cluster_culling = false;
+        } else if (arg == "--no-mesh-shading") {
+            settings.mesh_shading = false;
+        } else if (arg == "--msaa") {
+            settings.msaa_samples = next_value();
+        } else if (arg == "--wireframe") {
+            settings.wireframe = true;
+        } else if (arg == "--depth-only") {
+            settings.depth_only = true;
+        } else if (arg == "--blend") {
+            settings.blended = true;
+        } else if (arg == "--no-dynamic-rendering") {
+            settings.dynamic_rendering = false;
+        } else if (arg == "--record-threads") {
+            settings.record_threads = next_value();
+        } else if (arg == "--benchmark") {
+            settings.benchmark_frames = next_value();
+        } else if (arg == "--benchmark-warmup") {
+            settings.benchmark_warmup_frames = next_value();
+        } else if (arg == "--benchmark-output") {
+            settings.benchmark_output = next_string();
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+
+    // Warmup frames are rendered but not measured
+    if (settings.benchmark_frames != 0) {
+        settings.frame_count = settings.benchmark_warmup_frames + settings.benchmark_frames;
+    } else if (settings.headless && !frame_count_set) {
+        settings.frame_count = default_headless_frame_count;
+    }
+
+    return settings;
+}
+
+int main(int argc, char* argv[]) {
     try {
+        Application app(parse_settings(argc, argv));
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -14,4 +121,4 @@ int main() {
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
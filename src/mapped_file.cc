@@ -0,0 +1,127 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        file_handle = nullptr;
+        throw std::runtime_error("Failed to open: " + path);
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size)) {
+        close();
+        throw std::runtime_error("Failed to query size of: " + path);
+    }
+
+    // Empty files cannot be mapped
+    size = static_cast<size_t>(file_size.QuadPart);
+    if (size == 0) {
+        close();
+        throw std::runtime_error("Failed to map empty file: " + path);
+    }
+
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle == nullptr) {
+        close();
+        throw std::runtime_error("Failed to map: " + path);
+    }
+
+    data = static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (data == nullptr) {
+        close();
+        throw std::runtime_error("Failed to map: " + path);
+    }
+}
+
+void MappedFile::close() {
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+    if (file_handle != nullptr) CloseHandle(file_handle);
+
+    data = nullptr;
+    size = 0;
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Failed to open: " + path);
+    }
+
+    struct stat file_status;
+    if (fstat(fd, &file_status) == -1) {
+        ::close(fd);
+        throw std::runtime_error("Failed to query size of: " + path);
+    }
+
+    // Empty files cannot be mapped
+    size = static_cast<size_t>(file_status.st_size);
+    if (size == 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to map empty file: " + path);
+    }
+
+    // The mapping keeps its own reference to the file
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        throw std::runtime_error("Failed to map: " + path);
+    }
+
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapping);
+}
+
+void MappedFile::close() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+
+    data = nullptr;
+    size = 0;
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+#ifdef _WIN32
+        std::swap(file_handle, other.file_handle);
+        std::swap(mapping_handle, other.mapping_handle);
+#endif
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
@@ -0,0 +1,46 @@
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+#include <string>
+#include <cstddef>
+#include <streambuf>
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) noexcept;
+    MappedFile& operator=(MappedFile&&) noexcept;
+
+    ~MappedFile();
+
+    void close();
+
+    const char* get_data() const { return data; }
+    size_t get_size() const { return size; }
+    bool is_open() const { return data != nullptr; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
+
+// Get area over a mapping, lets parsers that want a std::istream read it without a copy
+class MappedFileBuffer : public std::streambuf {
+public:
+    explicit MappedFileBuffer(const MappedFile& file) {
+        char* begin = const_cast<char*>(file.get_data());
+        setg(begin, begin, begin + file.get_size());
+    }
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "memory_allocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+
+constexpr VkDeviceSize large_heap_block_size = 256ull * 1024 * 1024;
+constexpr VkDeviceSize small_heap_threshold = 1024ull * 1024 * 1024;
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Resources on the same bufferImageGranularity page must not mix linear and optimal tiling
+bool on_same_page(VkDeviceSize end_of_first, VkDeviceSize start_of_second, VkDeviceSize page_size) {
+    return (end_of_first - 1) / page_size == start_of_second / page_size;
+}
+
+bool try_allocate_from_block(MemoryBlock& block, const VkMemoryRequirements& requirements,
+                             bool linear, VkDeviceSize granularity, VkDeviceSize& allocation_offset) {
+    auto& suballocations = block.suballocations;
+
+    for (size_t i = 0; i < suballocations.size(); ++i) {
+        const auto range = suballocations[i];
+        if (!range.free || range.size < requirements.size) continue;
+
+        VkDeviceSize offset = align_up(range.offset, requirements.alignment);
+        if (i > 0) {
+            const auto& previous = suballocations[i - 1];
+            if (previous.linear != linear && on_same_page(previous.offset + previous.size, offset, granularity)) {
+                offset = align_up(offset, granularity);
+            }
+        }
+
+        VkDeviceSize end = offset + requirements.size;
+        if (end > range.offset + range.size) continue;
+
+        if (i + 1 < suballocations.size()) {
+            const auto& next = suballocations[i + 1];
+            if (next.linear != linear && on_same_page(end, next.offset, granularity)) continue;
+        }
+
+        // Split the free range into padding, the allocation and the remainder
+        std::vector<Suballocation> split;
+        if (offset > range.offset) {
+            split.push_back({range.offset, offset - range.offset, true, false});
+        }
+        split.push_back({offset, requirements.size, false, linear});
+        if (end < range.offset + range.size) {
+            split.push_back({end, range.offset + range.size - end, true, false});
+        }
+
+        suballocations.erase(suballocations.begin() + i);
+        suballocations.insert(suballocations.begin() + i, split.begin(), split.end());
+
+        ++block.allocation_count;
+        block.used_bytes += requirements.size;
+        allocation_offset = offset;
+        return true;
+    }
+
+    return false;
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    destroy();
+}
+
+void MemoryAllocator::init(VkPhysicalDevice physical_device, VkDevice _device) {
+    device = _device;
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    buffer_image_granularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    max_allocation_count = properties.limits.maxMemoryAllocationCount;
+
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+    // Small heaps (integrated GPUs, host visible BAR) get proportionally smaller blocks
+    block_sizes.resize(memory_properties.memoryTypeCount);
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+        auto heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[i].heapIndex].size;
+        block_sizes[i] = (heap_size <= small_heap_threshold) ? heap_size / 8 : large_heap_block_size;
+    }
+
+    blocks.resize(memory_properties.memoryTypeCount);
+}
+
+void MemoryAllocator::destroy() {
+    if (device == VK_NULL_HANDLE) return;
+
+    for (auto& type_blocks : blocks) {
+        for (auto& block : type_blocks) {
+            if (block->mapped != nullptr) {
+                vkUnmapMemory(device, block->memory);
+            }
+            vkFreeMemory(device, block->memory, nullptr);
+        }
+    }
+    blocks.clear();
+    vk_allocation_count = 0;
+    device = VK_NULL_HANDLE;
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear) {
+    uint32_t memory_type = find_memory_type(requirements.memoryTypeBits, properties);
+    auto& type_blocks = blocks[memory_type];
+
+    MemoryBlock* block = nullptr;
+    VkDeviceSize offset = 0;
+
+    // Resources larger than half a block would waste most of it, they get their own memory
+    VkDeviceSize block_size = block_sizes[memory_type];
+    if (requirements.size > block_size / 2) {
+        block = create_block(memory_type, requirements.size, true);
+        try_allocate_from_block(*block, requirements, linear, buffer_image_granularity, offset);
+    } else {
+        for (auto& candidate : type_blocks) {
+            if (candidate->dedicated) continue;
+            if (try_allocate_from_block(*candidate, requirements, linear, buffer_image_granularity, offset)) {
+                block = candidate.get();
+                break;
+            }
+        }
+
+        if (block == nullptr) {
+            block = create_block(memory_type, block_size, false);
+            if (!try_allocate_from_block(*block, requirements, linear, buffer_image_granularity, offset)) {
+                throw std::runtime_error("Failed to sub-allocate from a new memory block.");
+            }
+        }
+    }
+
+    Allocation allocation{};
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.mapped = (block->mapped != nullptr) ? static_cast<char*>(block->mapped) + offset : nullptr;
+    allocation.block = block;
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation) {
+    if (allocation.block == nullptr) return;
+
+    auto block = allocation.block;
+    auto& suballocations = block->suballocations;
+    auto it = std::lower_bound(suballocations.begin(), suballocations.end(), allocation.offset, [] (const auto& range, VkDeviceSize offset) {
+        return range.offset < offset;
+    });
+    if (it == suballocations.end() || it->offset != allocation.offset || it->free) {
+        throw std::runtime_error("Failed to free allocation not owned by its block.");
+    }
+
+    it->free = true;
+    it->linear = false;
+    --block->allocation_count;
+    block->used_bytes -= it->size;
+
+    // Merge with free neighbours
+    auto next = it + 1;
+    if (next != suballocations.end() && next->free) {
+        it->size += next->size;
+        it = std::prev(suballocations.erase(next));
+    }
+    if (it != suballocations.begin() && std::prev(it)->free) {
+        auto previous = std::prev(it);
+        previous->size += it->size;
+        suballocations.erase(it);
+    }
+
+    allocation = {};
+
+    // Keep one empty block per memory type around so that load/unload cycles do not thrash vkAllocateMemory
+    if (block->allocation_count == 0) {
+        auto& type_blocks = blocks[block->memory_type];
+        size_t shared_block_count = std::count_if(type_blocks.begin(), type_blocks.end(), [] (const auto& candidate) {
+            return !candidate->dedicated;
+        });
+        if (block->dedicated || shared_block_count > 1) {
+            destroy_block(block);
+        }
+    }
+}
+
+AllocatorStatistics MemoryAllocator::get_statistics() const {
+    AllocatorStatistics statistics;
+    for (const auto& type_blocks : blocks) {
+        for (const auto& block : type_blocks) {
+            ++statistics.block_count;
+            if (block->dedicated) ++statistics.dedicated_block_count;
+            statistics.allocation_count += block->allocation_count;
+            statistics.reserved_bytes += block->size;
+            statistics.used_bytes += block->used_bytes;
+        }
+    }
+    return statistics;
+}
+
+void MemoryAllocator::print_statistics() const {
+    auto statistics = get_statistics();
+    constexpr double mebibyte = 1024.0 * 1024.0;
+
+    std::cout << "Device memory: " << statistics.block_count << " block(s) ("
+              << statistics.dedicated_block_count << " dedicated), "
+              << std::fixed << std::setprecision(1)
+              << statistics.reserved_bytes / mebibyte << " MiB reserved, "
+              << statistics.used_bytes / mebibyte << " MiB used by "
+              << statistics.allocation_count << " allocation(s)\n";
+
+    for (uint32_t i = 0; i < blocks.size(); ++i) {
+        for (const auto& block : blocks[i]) {
+            std::cout << "\ttype " << i << ": " << block->size / mebibyte << " MiB, "
+                      << block->allocation_count << " allocation(s), "
+                      << 100.0 * block->used_bytes / block->size << "% used"
+                      << (block->dedicated ? " (dedicated)" : "") << '\n';
+        }
+    }
+    std::cout << std::endl;
+}
+
+uint32_t MemoryAllocator::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+        if ((type_filter & (1 << i)) &&
+            (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Failed to find suitable memory type.");
+}
+
+MemoryBlock* MemoryAllocator::create_block(uint32_t memory_type, VkDeviceSize size, bool dedicated) {
+    if (vk_allocation_count >= max_allocation_count) {
+        throw std::runtime_error("Failed to allocate memory block, maxMemoryAllocationCount reached.");
+    }
+
+    auto block = std::make_unique<MemoryBlock>();
+    block->size = size;
+    block->memory_type = memory_type;
+    block->dedicated = dedicated;
+    block->suballocations.push_back({0, size, true, false});
+
+    VkMemoryAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = size;
+    allocate_info.memoryTypeIndex = memory_type;
+
+    if (vkAllocateMemory(device, &allocate_info, nullptr, &block->memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate memory block.");
+    }
+    ++vk_allocation_count;
+
+    // Host visible blocks stay mapped for their whole lifetime
+    if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+            // The block itself is freed with the unique_ptr
+            vkFreeMemory(device, block->memory, nullptr);
+            --vk_allocation_count;
+            throw std::runtime_error("Failed to map memory block.");
+        }
+    }
+
+    blocks[memory_type].push_back(std::move(block));
+    return blocks[memory_type].back().get();
+}
+
+void MemoryAllocator::destroy_block(MemoryBlock* block) {
+    auto& type_blocks = blocks[block->memory_type];
+    auto it = std::find_if(type_blocks.begin(), type_blocks.end(), [=] (const auto& candidate) {
+        return candidate.get() == block;
+    });
+
+    if (block->mapped != nullptr) {
+        vkUnmapMemory(device, block->memory);
+    }
+    vkFreeMemory(device, block->memory, nullptr);
+    --vk_allocation_count;
+
+    type_blocks.erase(it);
+}
@@ -0,0 +1,85 @@
+#ifndef MEMORY_ALLOCATOR_H_INCLUDED
+#define MEMORY_ALLOCATOR_H_INCLUDED
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <memory>
+
+struct Suballocation {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    bool free;
+    bool linear;
+};
+
+struct MemoryBlock {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    uint32_t memory_type = 0;
+    bool dedicated = false;
+    void* mapped = nullptr;
+
+    // Sorted by offset and covering the whole block, adjacent free ranges are always merged
+    std::vector<Suballocation> suballocations;
+    uint32_t allocation_count = 0;
+    VkDeviceSize used_bytes = 0;
+};
+
+// A range of device memory handed out by MemoryAllocator
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    // Points at offset inside the persistently mapped block, null unless host visible
+    void* mapped = nullptr;
+
+    MemoryBlock* block = nullptr;
+};
+
+struct AllocatorStatistics {
+    uint32_t block_count = 0;
+    uint32_t dedicated_block_count = 0;
+    uint32_t allocation_count = 0;
+    VkDeviceSize reserved_bytes = 0;
+    VkDeviceSize used_bytes = 0;
+};
+
+// Sub-allocates buffers and images out of large blocks, one list of blocks per memory type
+class MemoryAllocator {
+public:
+    MemoryAllocator() = default;
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    ~MemoryAllocator();
+
+    void init(VkPhysicalDevice, VkDevice);
+    void destroy();
+
+    // Linear resources are buffers and linear-tiled images, the rest are kept
+    // bufferImageGranularity apart from them
+    Allocation allocate(const VkMemoryRequirements&, VkMemoryPropertyFlags, bool linear);
+    void free(Allocation&);
+
+    AllocatorStatistics get_statistics() const;
+    void print_statistics() const;
+
+private:
+    uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags) const;
+    MemoryBlock* create_block(uint32_t memory_type, VkDeviceSize size, bool dedicated);
+    void destroy_block(MemoryBlock*);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    VkDeviceSize buffer_image_granularity = 1;
+    uint32_t max_allocation_count = 0;
+    uint32_t vk_allocation_count = 0;
+
+    std::vector<VkDeviceSize> block_sizes;
+    std::vector<std::vector<std::unique_ptr<MemoryBlock>>> blocks;
+};
+
+#endif
@@ -0,0 +1,192 @@
+// Measures vertex deduplication against the previous std::unordered_map implementation.
+//
+//     ./mesh_benchmark [model.obj] [--grid N] [--runs N] [--threads N]
+//
+// Without a model a mirrored N x N grid is generated, which is the worst case for the old hash.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include <tiny_obj_loader.h>
+
+#include "mesh_deduplication.h"
+
+// The hash load_model used before, kept for comparison
+struct LegacyVertexHash {
+    size_t operator() (const Vertex& vertex) const {
+        return ((std::hash<glm::vec3>()(vertex.pos) ^
+        (std::hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+        (std::hash<glm::vec2>()(vertex.tex_coord) << 1);
+    }
+};
+
+void deduplicate_vertices_legacy(const std::vector<Vertex>& corners,
+                                 std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    std::unordered_map<Vertex, uint32_t, LegacyVertexHash> unique_vertices{};
+    for (const auto& vertex : corners) {
+        if (unique_vertices.find(vertex) == unique_vertices.end()) {
+            unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(vertex);
+        }
+        indices.push_back(unique_vertices[vertex]);
+    }
+}
+
+std::vector<Vertex> load_corners(const std::string& path) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warning, error;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, path.c_str())) {
+        throw std::runtime_error(warning + error);
+    }
+
+    std::vector<Vertex> corners;
+    for (const auto& shape : shapes) {
+        for (const auto& index : shape.mesh.indices) {
+            Vertex vertex{};
+            vertex.pos = {
+                attrib.vertices[3 * index.vertex_index + 0],
+                attrib.vertices[3 * index.vertex_index + 1],
+                attrib.vertices[3 * index.vertex_index + 2],
+            };
+            if (index.texcoord_index >= 0) {
+                vertex.tex_coord = {
+                    attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1],
+                };
+            }
+            vertex.color = {1.0f, 1.0f, 1.0f};
+            corners.push_back(vertex);
+        }
+    }
+    return corners;
+}
+
+// Two triangles per cell, centered on the origin so every position has mirrored twins
+std::vector<Vertex> generate_grid_corners(uint32_t grid_size) {
+    std::vector<Vertex> corners;
+    corners.reserve(static_cast<size_t>(grid_size) * grid_size * 6);
+
+    auto make_vertex = [=] (uint32_t x, uint32_t y) {
+        Vertex vertex{};
+        vertex.pos = {
+            static_cast<float>(x) - grid_size / 2.0f,
+            static_cast<float>(y) - grid_size / 2.0f,
+            0.0f,
+        };
+        vertex.color = {1.0f, 1.0f, 1.0f};
+        vertex.tex_coord = {static_cast<float>(x) / grid_size, static_cast<float>(y) / grid_size};
+        return vertex;
+    };
+
+    for (uint32_t y = 0; y < grid_size; ++y) {
+        for (uint32_t x = 0; x < grid_size; ++x) {
+            corners.push_back(make_vertex(x, y));
+            corners.push_back(make_vertex(x + 1, y));
+            corners.push_back(make_vertex(x + 1, y + 1));
+            corners.push_back(make_vertex(x, y));
+            corners.push_back(make_vertex(x + 1, y + 1));
+            corners.push_back(make_vertex(x, y + 1));
+        }
+    }
+    return corners;
+}
+
+template<typename F>
+double measure_milliseconds(uint32_t runs, F&& function) {
+    double best = std::numeric_limits<double>::max();
+    for (uint32_t i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        std::string model_path;
+        uint32_t grid_size = 1000;
+        uint32_t runs = 3;
+        uint32_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto next_value = [&] () -> uint32_t {
+                if (i + 1 >= argc) {
+                    throw std::runtime_error("Missing value for " + arg + ".");
+                }
+                return static_cast<uint32_t>(std::stoul(argv[++i]));
+            };
+
+            if (arg == "--grid") {
+                grid_size = next_value();
+            } else if (arg == "--runs") {
+                runs = std::max(1u, next_value());
+            } else if (arg == "--threads") {
+                thread_count = std::max(1u, next_value());
+            } else {
+                model_path = arg;
+            }
+        }
+
+        auto corners = model_path.empty() ? generate_grid_corners(grid_size) : load_corners(model_path);
+        std::cout << "Deduplicating " << corners.size() << " corners from "
+                  << (model_path.empty() ? "a " + std::to_string(grid_size) + "x" + std::to_string(grid_size) + " grid" : model_path)
+                  << ", best of " << runs << " run(s)\n";
+
+        std::vector<Vertex> legacy_vertices, vertices;
+        std::vector<uint32_t> legacy_indices, indices;
+
+        double legacy_time = measure_milliseconds(runs, [&] () {
+            legacy_vertices.clear();
+            legacy_indices.clear();
+            deduplicate_vertices_legacy(corners, legacy_vertices, legacy_indices);
+        });
+
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << '\t' << std::left << std::setw(28) << "unordered_map (legacy)" << std::right
+                  << std::setw(10) << legacy_time << " ms\n";
+
+        // Powers of two up to the requested thread count, plus the count itself
+        std::vector<uint32_t> thread_counts;
+        for (uint32_t threads = 1; threads < thread_count; threads *= 2) {
+            thread_counts.push_back(threads);
+        }
+        thread_counts.push_back(thread_count);
+
+        bool matches = true;
+        for (uint32_t threads : thread_counts) {
+            double time = measure_milliseconds(runs, [&] () {
+                deduplicate_vertices(corners, vertices, indices, threads);
+            });
+            matches &= (vertices == legacy_vertices && indices == legacy_indices);
+
+            std::cout << '\t' << std::left << std::setw(28) << ("open addressing, " + std::to_string(threads) + " thread(s)") << std::right
+                      << std::setw(10) << time << " ms" << std::setw(10) << legacy_time / time << "x\n";
+        }
+
+        std::cout << legacy_vertices.size() << " unique vertices, output "
+                  << (matches ? "identical to" : "DIFFERENT from") << " the legacy implementation" << std::endl;
+        if (!matches) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
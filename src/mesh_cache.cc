@@ -0,0 +1,115 @@
+#include "mesh_cache.h"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <stdexcept>
+
+constexpr char mesh_cache_magic[4] = {'L', 'V', 'M', 'C'};
+
+uint64_t hash_file(const std::string& path) {
+    return hash_file(MappedFile(path));
+}
+
+uint64_t hash_file(const MappedFile& file) {
+    uint64_t hash = 14695981039346656037ull;
+    const auto data = reinterpret_cast<const unsigned char*>(file.get_data());
+    for (size_t i = 0; i < file.get_size(); ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool MeshCache::load(const std::string& path, uint64_t source_hash, uint32_t vertex_stride, uint32_t flags) {
+    close();
+    if (!std::filesystem::exists(path)) return false;
+
+    file = MappedFile(path);
+    if (file.get_size() < sizeof(MeshCacheHeader)) {
+        close();
+        return false;
+    }
+
+    // mmap returns page aligned memory, so the header and the arrays behind it are suitably aligned
+    header = reinterpret_cast<const MeshCacheHeader*>(file.get_data());
+    uint64_t expected_size = sizeof(MeshCacheHeader) +
+                             static_cast<uint64_t>(header->vertex_count) * header->vertex_stride +
+                             static_cast<uint64_t>(header->index_count) * sizeof(uint32_t) +
+                             static_cast<uint64_t>(header->lod_count) * sizeof(MeshCacheLod);
+
+    bool valid = std::memcmp(header->magic, mesh_cache_magic, sizeof(mesh_cache_magic)) == 0 &&
+                 header->version == mesh_cache_version &&
+                 header->source_hash == source_hash &&
+                 header->vertex_stride == vertex_stride &&
+                 header->flags == flags &&
+                 header->lod_count > 0 &&
+                 file.get_size() == expected_size;
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    // Every level has to lie within the indices
+    auto lods = get_lods();
+    for (uint32_t i = 0; i < header->lod_count; ++i) {
+        if (lods[i].first_index > header->index_count || lods[i].index_count > header->index_count - lods[i].first_index) {
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MeshCache::close() {
+    file.close();
+    header = nullptr;
+}
+
+void MeshCache::write(const std::string& path, uint64_t source_hash, uint32_t vertex_stride, uint32_t flags,
+                      const void* vertices, uint32_t vertex_count,
+                      const uint32_t* indices, uint32_t index_count,
+                      const MeshCacheLod* lods, uint32_t lod_count) {
+    MeshCacheHeader cache_header{};
+    std::memcpy(cache_header.magic, mesh_cache_magic, sizeof(mesh_cache_magic));
+    cache_header.version = mesh_cache_version;
+    cache_header.source_hash = source_hash;
+    cache_header.vertex_stride = vertex_stride;
+    cache_header.vertex_count = vertex_count;
+    cache_header.index_count = index_count;
+    cache_header.flags = flags;
+    cache_header.lod_count = lod_count;
+
+    // Written next to the destination and renamed over it, so a crash never leaves a truncated cache
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream cache_file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!cache_file.is_open()) {
+            throw std::runtime_error("Failed to open: " + temporary_path);
+        }
+
+        cache_file.write(reinterpret_cast<const char*>(&cache_header), sizeof(cache_header));
+        cache_file.write(static_cast<const char*>(vertices), static_cast<std::streamsize>(vertex_count) * vertex_stride);
+        cache_file.write(reinterpret_cast<const char*>(indices), static_cast<std::streamsize>(index_count) * sizeof(uint32_t));
+        cache_file.write(reinterpret_cast<const char*>(lods), static_cast<std::streamsize>(lod_count) * sizeof(MeshCacheLod));
+        if (!cache_file) {
+            throw std::runtime_error("Failed to write: " + temporary_path);
+        }
+    }
+
+    std::filesystem::rename(temporary_path, path);
+}
+
+const void* MeshCache::get_vertices() const {
+    return file.get_data() + sizeof(MeshCacheHeader);
+}
+
+const uint32_t* MeshCache::get_indices() const {
+    auto vertex_bytes = static_cast<size_t>(header->vertex_count) * header->vertex_stride;
+    return reinterpret_cast<const uint32_t*>(file.get_data() + sizeof(MeshCacheHeader) + vertex_bytes);
+}
+
+const MeshCacheLod* MeshCache::get_lods() const {
+    return reinterpret_cast<const MeshCacheLod*>(get_indices() + header->index_count);
+}
@@ -0,0 +1,67 @@
+#ifndef MESH_CACHE_H_INCLUDED
+#define MESH_CACHE_H_INCLUDED
+
+#include <string>
+#include <cstdint>
+
+#include "mapped_file.h"
+
+// Bump whenever the layout or the processing that produces the cached data changes
+constexpr uint32_t mesh_cache_version = 3;
+
+// Optional processing the cached mesh went through, a cache built with other flags is rebuilt
+constexpr uint32_t mesh_cache_optimized = 1;
+constexpr uint32_t mesh_cache_overdraw_sorted = 2;
+
+// The requested number of levels of detail is kept in the flags above this bit
+constexpr uint32_t mesh_cache_lod_count_shift = 8;
+
+// Followed by vertex_count * vertex_stride bytes of vertices, index_count 32-bit indices with
+// those of every level of detail appended behind the full mesh, and lod_count MeshCacheLods
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t vertex_stride;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t flags;
+    uint32_t lod_count;
+};
+
+// Where a level of detail lies among the cached indices, the first one is the full mesh
+struct MeshCacheLod {
+    uint32_t first_index;
+    uint32_t index_count;
+    float error;
+};
+
+// 64-bit FNV-1a over the contents of a file
+uint64_t hash_file(const std::string& path);
+uint64_t hash_file(const MappedFile&);
+
+// Deduplicated mesh data read straight out of a memory mapped cache file
+class MeshCache {
+public:
+    // Returns false if the cache is missing, corrupt or was built from a different source
+    bool load(const std::string& path, uint64_t source_hash, uint32_t vertex_stride, uint32_t flags);
+    void close();
+
+    static void write(const std::string& path, uint64_t source_hash, uint32_t vertex_stride, uint32_t flags,
+                      const void* vertices, uint32_t vertex_count,
+                      const uint32_t* indices, uint32_t index_count,
+                      const MeshCacheLod* lods, uint32_t lod_count);
+
+    const void* get_vertices() const;
+    const uint32_t* get_indices() const;
+    const MeshCacheLod* get_lods() const;
+    uint32_t get_vertex_count() const { return header->vertex_count; }
+    uint32_t get_index_count() const { return header->index_count; }
+    uint32_t get_lod_count() const { return header->lod_count; }
+
+private:
+    MappedFile file;
+    const MeshCacheHeader* header = nullptr;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "mesh_deduplication.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+constexpr uint32_t empty_slot = std::numeric_limits<uint32_t>::max();
+
+// Below this many corners per thread the cost of spawning threads outweighs the work
+constexpr size_t min_corners_per_thread = 64 * 1024;
+
+// Shards are claimed dynamically, more shards than threads evens out the load
+constexpr uint32_t shards_per_thread = 4;
+
+size_t next_power_of_two(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+void run_on_threads(uint32_t thread_count, const std::function<void(uint32_t)>& task) {
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (uint32_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(task, i);
+    }
+    task(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Open addressing table with linear probing. Slots hold corner indices, so the
+// table is 4 bytes per slot and the vertices themselves are never copied
+class VertexTable {
+public:
+    VertexTable(const std::vector<Vertex>& _corners, const std::vector<uint64_t>& _hashes, size_t max_count)
+        : corners(_corners), hashes(_hashes) {
+        // Kept at most half full
+        slots.assign(next_power_of_two(std::max<size_t>(2 * max_count, 16)), empty_slot);
+        mask = slots.size() - 1;
+    }
+
+    // Returns the first corner equal to the given one, which is the corner itself if it is new
+    uint32_t find_or_insert(uint32_t corner) {
+        uint64_t hash = hashes[corner];
+        for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+            uint32_t candidate = slots[slot];
+            if (candidate == empty_slot) {
+                slots[slot] = corner;
+                return corner;
+            }
+            if (hashes[candidate] == hash && corners[candidate] == corners[corner]) {
+                return candidate;
+            }
+        }
+    }
+
+private:
+    const std::vector<Vertex>& corners;
+    const std::vector<uint64_t>& hashes;
+    std::vector<uint32_t> slots;
+    size_t mask;
+};
+
+void deduplicate_vertices(const std::vector<Vertex>& corners,
+                          std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+                          uint32_t thread_count) {
+    const size_t corner_count = corners.size();
+    if (corner_count >= empty_slot) {
+        throw std::runtime_error("Failed to deduplicate mesh, too many corners for 32-bit indices.");
+    }
+
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    thread_count = static_cast<uint32_t>(std::clamp<size_t>(corner_count / min_corners_per_thread, 1, thread_count));
+
+    // Shards are selected by the top bits of the hash, the tables index with the low bits
+    const uint32_t shard_count = static_cast<uint32_t>(next_power_of_two(thread_count * shards_per_thread));
+    uint32_t shard_shift = 64;
+    for (uint32_t i = shard_count; i > 1; i >>= 1) --shard_shift;
+    auto get_shard = [=] (uint64_t hash) {
+        return (shard_count == 1) ? 0u : static_cast<uint32_t>(hash >> shard_shift);
+    };
+
+    // Every thread owns one contiguous chunk of corners
+    std::vector<size_t> chunk_begin(thread_count + 1);
+    for (uint32_t i = 0; i <= thread_count; ++i) {
+        chunk_begin[i] = corner_count * i / thread_count;
+    }
+
+    // Hash every corner and count how many land in each shard per chunk
+    std::vector<uint64_t> hashes(corner_count);
+    std::vector<size_t> shard_offsets(static_cast<size_t>(thread_count) * shard_count, 0);
+    run_on_threads(thread_count, [&] (uint32_t chunk) {
+        size_t* counts = &shard_offsets[static_cast<size_t>(chunk) * shard_count];
+        for (size_t i = chunk_begin[chunk]; i < chunk_begin[chunk + 1]; ++i) {
+            hashes[i] = hash_vertex(corners[i]);
+            ++counts[get_shard(hashes[i])];
+        }
+    });
+
+    // Lay the shards out one after another, each ordered by chunk, so a shard lists its corners in ascending order
+    std::vector<size_t> shard_begin(shard_count + 1, 0);
+    size_t offset = 0;
+    for (uint32_t shard = 0; shard < shard_count; ++shard) {
+        shard_begin[shard] = offset;
+        for (uint32_t chunk = 0; chunk < thread_count; ++chunk) {
+            size_t count = shard_offsets[static_cast<size_t>(chunk) * shard_count + shard];
+            shard_offsets[static_cast<size_t>(chunk) * shard_count + shard] = offset;
+            offset += count;
+        }
+    }
+    shard_begin[shard_count] = offset;
+
+    std::vector<uint32_t> shard_corners(corner_count);
+    run_on_threads(thread_count, [&] (uint32_t chunk) {
+        size_t* offsets = &shard_offsets[static_cast<size_t>(chunk) * shard_count];
+        for (size_t i = chunk_begin[chunk]; i < chunk_begin[chunk + 1]; ++i) {
+            shard_corners[offsets[get_shard(hashes[i])]++] = static_cast<uint32_t>(i);
+        }
+    });
+
+    // Equal corners always share a shard, so each shard finds the first occurrence of its corners on its own
+    std::vector<uint32_t> first_corner(corner_count);
+    std::atomic<uint32_t> next_shard = 0;
+    run_on_threads(thread_count, [&] (uint32_t) {
+        for (uint32_t shard = next_shard++; shard < shard_count; shard = next_shard++) {
+            VertexTable table(corners, hashes, shard_begin[shard + 1] - shard_begin[shard]);
+            for (size_t i = shard_begin[shard]; i < shard_begin[shard + 1]; ++i) {
+                uint32_t corner = shard_corners[i];
+                first_corner[corner] = table.find_or_insert(corner);
+            }
+        }
+    });
+
+    // Number the unique vertices in corner order, which matches a sequential first-use numbering
+    std::vector<uint32_t> chunk_vertex_offsets(thread_count + 1, 0);
+    run_on_threads(thread_count, [&] (uint32_t chunk) {
+        uint32_t count = 0;
+        for (size_t i = chunk_begin[chunk]; i < chunk_begin[chunk + 1]; ++i) {
+            count += (first_corner[i] == i);
+        }
+        chunk_vertex_offsets[chunk + 1] = count;
+    });
+    for (uint32_t chunk = 0; chunk < thread_count; ++chunk) {
+        chunk_vertex_offsets[chunk + 1] += chunk_vertex_offsets[chunk];
+    }
+
+    // Reuses shard_corners to map a first corner to its vertex index
+    auto& vertex_index = shard_corners;
+    vertices.resize(chunk_vertex_offsets[thread_count]);
+    run_on_threads(thread_count, [&] (uint32_t chunk) {
+        uint32_t next_vertex = chunk_vertex_offsets[chunk];
+        for (size_t i = chunk_begin[chunk]; i < chunk_begin[chunk + 1]; ++i) {
+            if (first_corner[i] == i) {
+                vertex_index[i] = next_vertex;
+                vertices[next_vertex++] = corners[i];
+            }
+        }
+    });
+
+    // First corners never come after the corners referring to them, but may live in another chunk
+    indices.resize(corner_count);
+    run_on_threads(thread_count, [&] (uint32_t chunk) {
+        for (size_t i = chunk_begin[chunk]; i < chunk_begin[chunk + 1]; ++i) {
+            indices[i] = vertex_index[first_corner[i]];
+        }
+    });
+}
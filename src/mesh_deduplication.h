@@ -0,0 +1,16 @@
+#ifndef MESH_DEDUPLICATION_H_INCLUDED
+#define MESH_DEDUPLICATION_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+
+#include "vertex.h"
+
+// Collapses identical corners into unique vertices and an index list referring to them.
+// Vertices come out in order of first use, exactly as a sequential pass would produce,
+// independent of thread_count. A thread_count of 0 uses every hardware thread
+void deduplicate_vertices(const std::vector<Vertex>& corners,
+                          std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+                          uint32_t thread_count = 0);
+
+#endif
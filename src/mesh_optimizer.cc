@@ -0,0 +1,328 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+constexpr uint32_t invalid_index = std::numeric_limits<uint32_t>::max();
+
+// Scoring parameters from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr uint32_t forsyth_cache_size = 32;
+constexpr float cache_decay_power = 1.5f;
+constexpr float last_triangle_score = 0.75f;
+constexpr float valence_boost_scale = 2.0f;
+constexpr float valence_boost_power = 0.5f;
+
+// Valences above this score like it, which only matters for fans around a single vertex
+constexpr uint32_t max_scored_valence = 64;
+
+struct ForsythScores {
+    std::array<float, forsyth_cache_size> cache_position;
+    std::array<float, max_scored_valence> valence;
+};
+
+ForsythScores build_forsyth_scores() {
+    ForsythScores scores;
+
+    // The three vertices of the last triangle get a fixed score, whichever of them is
+    // emitted next it is a hit, so the order among them should not matter
+    for (uint32_t i = 0; i < forsyth_cache_size; ++i) {
+        if (i < 3) {
+            scores.cache_position[i] = last_triangle_score;
+        } else {
+            float scale = 1.0f / static_cast<float>(forsyth_cache_size - 3);
+            scores.cache_position[i] = std::pow(1.0f - static_cast<float>(i - 3) * scale, cache_decay_power);
+        }
+    }
+
+    // Vertices with few triangles left are boosted, so they are finished off instead of
+    // being left behind as isolated triangles that miss the cache later on
+    scores.valence[0] = 0.0f;
+    for (uint32_t i = 1; i < max_scored_valence; ++i) {
+        scores.valence[i] = valence_boost_scale * std::pow(static_cast<float>(i), -valence_boost_power);
+    }
+
+    return scores;
+}
+
+float get_vertex_score(const ForsythScores& scores, int32_t cache_position, uint32_t remaining_triangles) {
+    if (remaining_triangles == 0) return -1.0f;
+
+    float score = scores.valence[std::min(remaining_triangles, max_scored_valence - 1)];
+    if (cache_position >= 0) {
+        score += scores.cache_position[cache_position];
+    }
+    return score;
+}
+
+VertexCacheStatistics analyze_vertex_cache(const uint32_t* indices, size_t index_count, uint32_t vertex_count,
+                                           uint32_t cache_size) {
+    VertexCacheStatistics statistics;
+    if (index_count < 3 || vertex_count == 0) return statistics;
+
+    // A vertex is in the FIFO if fewer than cache_size vertices were transformed since it was
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    uint32_t timestamp = cache_size + 1;
+    for (size_t i = 0; i < index_count; ++i) {
+        uint32_t index = indices[i];
+        if (timestamp - timestamps[index] > cache_size) {
+            timestamps[index] = timestamp++;
+            ++statistics.transformed_count;
+        }
+    }
+
+    statistics.acmr = static_cast<double>(statistics.transformed_count) / static_cast<double>(index_count / 3);
+    statistics.atvr = static_cast<double>(statistics.transformed_count) / static_cast<double>(vertex_count);
+    return statistics;
+}
+
+void optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) return;
+
+    // Triangles of every vertex, the ones not emitted yet are kept in front of its range
+    std::vector<uint32_t> remaining_triangles(vertex_count, 0);
+    for (uint32_t index : indices) {
+        ++remaining_triangles[index];
+    }
+
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        offsets[i + 1] = offsets[i] + remaining_triangles[i];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    auto scores = build_forsyth_scores();
+    std::vector<int32_t> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        vertex_scores[i] = get_vertex_score(scores, -1, remaining_triangles[i]);
+    }
+
+    auto get_triangle_score = [&] (uint32_t triangle) {
+        const uint32_t* corners = &indices[3 * triangle];
+        return vertex_scores[corners[0]] + vertex_scores[corners[1]] + vertex_scores[corners[2]];
+    };
+
+    // Nothing is cached yet, so the first triangle is the one with the lowest valences
+    uint32_t best_triangle = 0;
+    float best_score = get_triangle_score(0);
+    for (uint32_t i = 1; i < triangle_count; ++i) {
+        float score = get_triangle_score(i);
+        if (score > best_score) {
+            best_triangle = i;
+            best_score = score;
+        }
+    }
+
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint32_t> cache, next_cache;
+    cache.reserve(forsyth_cache_size + 3);
+    next_cache.reserve(forsyth_cache_size + 3);
+
+    std::vector<uint32_t> optimized;
+    optimized.reserve(indices.size());
+
+    size_t input_cursor = 0;
+    for (size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+        // Dead end, no cached vertex has triangles left. Forsyth rescans every triangle here,
+        // resuming in input order keeps the whole pass linear and rarely costs a miss more
+        if (best_triangle == invalid_index) {
+            while (emitted[input_cursor]) ++input_cursor;
+            best_triangle = static_cast<uint32_t>(input_cursor);
+        }
+
+        const uint32_t* corners = &indices[3 * best_triangle];
+        emitted[best_triangle] = 1;
+        optimized.insert(optimized.end(), corners, corners + 3);
+
+        for (uint32_t i = 0; i < 3; ++i) {
+            uint32_t vertex = corners[i];
+            auto begin = adjacency.begin() + offsets[vertex];
+            auto end = begin + remaining_triangles[vertex];
+            std::iter_swap(std::find(begin, end, best_triangle), end - 1);
+            --remaining_triangles[vertex];
+        }
+
+        // The emitted vertices move to the front of the LRU, the others keep their order behind them
+        next_cache.clear();
+        for (uint32_t i = 0; i < 3; ++i) {
+            if (std::find(next_cache.begin(), next_cache.end(), corners[i]) == next_cache.end()) {
+                next_cache.push_back(corners[i]);
+            }
+        }
+        for (uint32_t vertex : cache) {
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) {
+                next_cache.push_back(vertex);
+            }
+        }
+
+        // Only vertices in the cache, or just pushed out of it, change their score
+        for (size_t i = 0; i < next_cache.size(); ++i) {
+            uint32_t vertex = next_cache[i];
+            cache_positions[vertex] = (i < forsyth_cache_size) ? static_cast<int32_t>(i) : -1;
+            vertex_scores[vertex] = get_vertex_score(scores, cache_positions[vertex], remaining_triangles[vertex]);
+        }
+
+        best_triangle = invalid_index;
+        best_score = std::numeric_limits<float>::lowest();
+        next_cache.resize(std::min<size_t>(next_cache.size(), forsyth_cache_size));
+        for (uint32_t vertex : next_cache) {
+            auto begin = adjacency.begin() + offsets[vertex];
+            auto end = begin + remaining_triangles[vertex];
+            for (auto it = begin; it != end; ++it) {
+                float score = get_triangle_score(*it);
+                if (score > best_score) {
+                    best_triangle = *it;
+                    best_score = score;
+                }
+            }
+        }
+
+        std::swap(cache, next_cache);
+    }
+
+    indices = std::move(optimized);
+}
+
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) return;
+
+    // Same FIFO as analyze_vertex_cache, advancing the timestamp past the cache size flushes it
+    std::vector<uint32_t> timestamps(vertices.size(), 0);
+    uint32_t timestamp = analysis_cache_size + 1;
+    auto count_misses = [&] (size_t triangle) {
+        uint32_t misses = 0;
+        for (size_t i = 3 * triangle; i < 3 * triangle + 3; ++i) {
+            if (timestamp - timestamps[indices[i]] > analysis_cache_size) {
+                timestamps[indices[i]] = timestamp++;
+                ++misses;
+            }
+        }
+        return misses;
+    };
+    auto flush_cache = [&] () {
+        timestamp += analysis_cache_size + 1;
+    };
+
+    // A triangle that misses on all three vertices starts a patch disjoint from the ones
+    // before it, reordering between patches never costs a cache miss
+    std::vector<size_t> hard_boundaries;
+    for (size_t i = 0; i < triangle_count; ++i) {
+        if (count_misses(i) == 3 || i == 0) {
+            hard_boundaries.push_back(i);
+        }
+    }
+    hard_boundaries.push_back(triangle_count);
+
+    // Patches are split further wherever the ACMR since the last split has come down to
+    // threshold times the ACMR of the whole patch, trading a few misses for finer sorting
+    std::vector<size_t> cluster_starts;
+    for (size_t h = 0; h + 1 < hard_boundaries.size(); ++h) {
+        size_t begin = hard_boundaries[h];
+        size_t end = hard_boundaries[h + 1];
+
+        flush_cache();
+        uint32_t patch_misses = 0;
+        for (size_t i = begin; i < end; ++i) {
+            patch_misses += count_misses(i);
+        }
+        float cluster_threshold = threshold * static_cast<float>(patch_misses) / static_cast<float>(end - begin);
+
+        flush_cache();
+        cluster_starts.push_back(begin);
+        uint32_t running_misses = 0;
+        uint32_t running_triangles = 0;
+        for (size_t i = begin; i < end; ++i) {
+            running_misses += count_misses(i);
+            ++running_triangles;
+            if (i + 1 < end && static_cast<float>(running_misses) <= cluster_threshold * static_cast<float>(running_triangles)) {
+                cluster_starts.push_back(i + 1);
+                flush_cache();
+                running_misses = 0;
+                running_triangles = 0;
+            }
+        }
+    }
+    cluster_starts.push_back(triangle_count);
+
+    glm::vec3 mesh_centroid(0.0f);
+    for (uint32_t index : indices) {
+        mesh_centroid += vertices[index].pos;
+    }
+    mesh_centroid /= static_cast<float>(indices.size());
+
+    // Clusters whose area weighted normal points away from the center of the mesh, measured
+    // at their area weighted centroid, are the likely occluders and are drawn first
+    size_t cluster_count = cluster_starts.size() - 1;
+    std::vector<float> sort_keys(cluster_count);
+    for (size_t cluster = 0; cluster < cluster_count; ++cluster) {
+        glm::vec3 normal(0.0f);
+        glm::vec3 weighted_centroid(0.0f);
+        float area = 0.0f;
+        for (size_t i = cluster_starts[cluster]; i < cluster_starts[cluster + 1]; ++i) {
+            const auto& a = vertices[indices[3 * i + 0]].pos;
+            const auto& b = vertices[indices[3 * i + 1]].pos;
+            const auto& c = vertices[indices[3 * i + 2]].pos;
+            glm::vec3 cross = glm::cross(b - a, c - a);
+            float triangle_area = glm::length(cross);
+            normal += cross;
+            weighted_centroid += (a + b + c) * (triangle_area / 3.0f);
+            area += triangle_area;
+        }
+
+        float normal_length = glm::length(normal);
+        if (area == 0.0f || normal_length == 0.0f) {
+            sort_keys[cluster] = 0.0f;
+            continue;
+        }
+        sort_keys[cluster] = glm::dot(weighted_centroid / area - mesh_centroid, normal / normal_length);
+    }
+
+    std::vector<uint32_t> cluster_order(cluster_count);
+    std::iota(cluster_order.begin(), cluster_order.end(), 0u);
+    std::stable_sort(cluster_order.begin(), cluster_order.end(), [&] (uint32_t lhs, uint32_t rhs) {
+        return sort_keys[lhs] > sort_keys[rhs];
+    });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (uint32_t cluster : cluster_order) {
+        sorted.insert(sorted.end(), indices.begin() + 3 * cluster_starts[cluster], indices.begin() + 3 * cluster_starts[cluster + 1]);
+    }
+    indices = std::move(sorted);
+}
+
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> remap(vertices.size(), invalid_index);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (auto& index : indices) {
+        if (remap[index] == invalid_index) {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(reordered);
+}
+
+void optimize_mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool sort_overdraw) {
+    optimize_vertex_cache(indices, static_cast<uint32_t>(vertices.size()));
+    if (sort_overdraw) {
+        optimize_overdraw(indices, vertices);
+    }
+    optimize_vertex_fetch(vertices, indices);
+}
@@ -0,0 +1,44 @@
+#ifndef MESH_OPTIMIZER_H_INCLUDED
+#define MESH_OPTIMIZER_H_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "vertex.h"
+
+// Size of the FIFO post-transform cache the statistics are measured with, small enough
+// to be a conservative estimate for current GPUs
+constexpr uint32_t analysis_cache_size = 16;
+
+struct VertexCacheStatistics {
+    uint32_t transformed_count = 0;
+
+    // Average cache miss ratio, transformed vertices per triangle. 3 at worst, about 0.5 for a regular grid
+    double acmr = 0.0;
+
+    // Average transform to vertex ratio, transformed vertices per unique vertex. 1 at best
+    double atvr = 0.0;
+};
+
+VertexCacheStatistics analyze_vertex_cache(const uint32_t* indices, size_t index_count, uint32_t vertex_count,
+                                           uint32_t cache_size = analysis_cache_size);
+
+// Reorders triangles for the post-transform cache with Forsyth's linear-speed algorithm,
+// greedily emitting the triangle whose vertices score best for an LRU cache of 32 entries
+void optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count);
+
+// Splits a cache optimized triangle order into clusters that keep the ACMR within threshold
+// times that of the cluster they come from, and sorts the clusters so that the ones facing
+// away from the center of the mesh are drawn first (Sander, Nehab and Barczak 2007). Those
+// tend to occlude the others, so fewer fragments are shaded and then overwritten
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Renumbers vertices in order of first use by the index buffer, so vertex fetch walks memory
+// forward. Vertices no triangle refers to are dropped
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Runs the stages above in order, the overdraw sort only if requested
+void optimize_mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool sort_overdraw);
+
+#endif
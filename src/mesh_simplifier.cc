@@ -0,0 +1,329 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// A level has to drop at least this share of the triangles of the one before to be worth drawing
+constexpr float min_level_reduction = 0.15f;
+
+// Levels below this many triangles are never built
+constexpr uint32_t min_level_triangle_count = 32;
+
+// Symmetric 4x4 matrix summing the squared distances to a set of planes, weighted by area
+struct Quadric {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+    double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+    double a22 = 0.0, a23 = 0.0;
+    double a33 = 0.0;
+    double weight = 0.0;
+};
+
+void add_plane(Quadric& quadric, const glm::vec3& normal, float distance, float weight) {
+    double a = normal.x, b = normal.y, c = normal.z, d = distance;
+    quadric.a00 += weight * a * a;
+    quadric.a01 += weight * a * b;
+    quadric.a02 += weight * a * c;
+    quadric.a03 += weight * a * d;
+    quadric.a11 += weight * b * b;
+    quadric.a12 += weight * b * c;
+    quadric.a13 += weight * b * d;
+    quadric.a22 += weight * c * c;
+    quadric.a23 += weight * c * d;
+    quadric.a33 += weight * d * d;
+    quadric.weight += weight;
+}
+
+void add_quadric(Quadric& quadric, const Quadric& other) {
+    quadric.a00 += other.a00;
+    quadric.a01 += other.a01;
+    quadric.a02 += other.a02;
+    quadric.a03 += other.a03;
+    quadric.a11 += other.a11;
+    quadric.a12 += other.a12;
+    quadric.a13 += other.a13;
+    quadric.a22 += other.a22;
+    quadric.a23 += other.a23;
+    quadric.a33 += other.a33;
+    quadric.weight += other.weight;
+}
+
+// Mean squared distance of position to the planes of both quadrics
+double get_collapse_cost(const Quadric& first, const Quadric& second, const glm::vec3& position) {
+    Quadric quadric = first;
+    add_quadric(quadric, second);
+    if (quadric.weight == 0.0) return 0.0;
+
+    double x = position.x, y = position.y, z = position.z;
+    double error = quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z + quadric.a33
+                 + 2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z)
+                 + 2.0 * (quadric.a03 * x + quadric.a13 * y + quadric.a23 * z);
+    return std::max(error, 0.0) / quadric.weight;
+}
+
+// Vertices that only differ in their other attributes share a position. Topology is built
+// over the first vertex of every such group, and a group of more than one is a seam
+struct Welding {
+    std::vector<uint32_t> representatives;
+
+    // Members of the group of representative r are order[group_offsets[r], group_offsets[r] + group_sizes[r])
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> group_offsets;
+    std::vector<uint32_t> group_sizes;
+};
+
+Welding weld_positions(const Vertex* vertices, uint32_t vertex_count) {
+    Welding welding;
+    welding.order.resize(vertex_count);
+    std::iota(welding.order.begin(), welding.order.end(), 0u);
+    std::sort(welding.order.begin(), welding.order.end(), [&] (uint32_t a, uint32_t b) {
+        const auto& pa = vertices[a].pos;
+        const auto& pb = vertices[b].pos;
+        if (pa.x != pb.x) return pa.x < pb.x;
+        if (pa.y != pb.y) return pa.y < pb.y;
+        if (pa.z != pb.z) return pa.z < pb.z;
+        return a < b;
+    });
+
+    welding.representatives.resize(vertex_count);
+    welding.group_offsets.assign(vertex_count, 0);
+    welding.group_sizes.assign(vertex_count, 0);
+    for (uint32_t begin = 0; begin < vertex_count;) {
+        uint32_t end = begin + 1;
+        while (end < vertex_count && vertices[welding.order[end]].pos == vertices[welding.order[begin]].pos) {
+            ++end;
+        }
+
+        uint32_t representative = welding.order[begin];
+        welding.group_offsets[representative] = begin;
+        welding.group_sizes[representative] = end - begin;
+        for (uint32_t i = begin; i < end; ++i) {
+            welding.representatives[welding.order[i]] = representative;
+        }
+        begin = end;
+    }
+    return welding;
+}
+
+// The member of a group whose texture coordinates are closest, which lies on the same side of the seam
+uint32_t find_closest_member(const Vertex* vertices, const Welding& welding, uint32_t representative, const glm::vec2& tex_coord) {
+    uint32_t closest = representative;
+    float closest_distance = std::numeric_limits<float>::max();
+    for (uint32_t i = 0; i < welding.group_sizes[representative]; ++i) {
+        uint32_t member = welding.order[welding.group_offsets[representative] + i];
+        glm::vec2 delta = vertices[member].tex_coord - tex_coord;
+        float distance = glm::dot(delta, delta);
+        if (distance < closest_distance) {
+            closest = member;
+            closest_distance = distance;
+        }
+    }
+    return closest;
+}
+
+// Seams, and the ends of edges only one triangle uses. A directed edge without its reverse is such an edge
+std::vector<uint8_t> find_locked_vertices(const Welding& welding, const std::vector<uint32_t>& triangles, uint32_t vertex_count) {
+    std::vector<uint8_t> locked(vertex_count, 0);
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        locked[i] = (welding.group_sizes[i] > 1);
+    }
+
+    std::vector<uint64_t> edges;
+    edges.reserve(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        for (size_t j = 0; j < 3; ++j) {
+            uint64_t from = triangles[i + j];
+            uint64_t to = triangles[i + (j + 1) % 3];
+            edges.push_back(from << 32 | to);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (uint64_t edge : edges) {
+        uint64_t reverse = edge << 32 | edge >> 32;
+        if (!std::binary_search(edges.begin(), edges.end(), reverse)) {
+            locked[edge >> 32] = 1;
+            locked[edge & 0xffffffff] = 1;
+        }
+    }
+    return locked;
+}
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+// Whether moving from onto to turns a remaining triangle around it by more than about 75
+// degrees, which folds it over or leaves a sliver. Positions are looked up through remap,
+// which holds the collapses made earlier in the same pass
+bool flips_triangle(const Vertex* vertices, const std::vector<uint32_t>& triangles, const std::vector<uint32_t>& remap,
+                    const uint32_t* adjacent_triangles, uint32_t adjacent_count, uint32_t from, uint32_t to) {
+    for (uint32_t i = 0; i < adjacent_count; ++i) {
+        const uint32_t* triangle = &triangles[3 * adjacent_triangles[i]];
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        for (int j = 0; j < 3; ++j) {
+            before[j] = vertices[remap[triangle[j]]].pos;
+            after[j] = (triangle[j] == from) ? vertices[to].pos : before[j];
+        }
+
+        glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normal_before, normal_after) <= 0.25f * glm::length(normal_before) * glm::length(normal_after)) return true;
+    }
+    return false;
+}
+
+// One pass of collapses along the edges of the welded triangles, cheapest first and every
+// vertex in at most one of them. Corners follow their vertex onto the member of its new group
+// on the same side of any seam, and triangles that become degenerate are dropped. Returns
+// the number of collapses
+uint32_t collapse_edges(const Vertex* vertices, const Welding& welding, const std::vector<uint8_t>& locked,
+                        std::vector<Quadric>& quadrics, std::vector<uint32_t>& triangles, std::vector<uint32_t>& corners,
+                        uint32_t target_triangle_count, double& max_cost) {
+    auto vertex_count = static_cast<uint32_t>(quadrics.size());
+    auto triangle_count = static_cast<uint32_t>(triangles.size() / 3);
+
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for (uint32_t vertex : triangles) {
+        ++adjacency_offsets[vertex + 1];
+    }
+    std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+    std::vector<uint32_t> adjacency(triangles.size());
+    std::vector<uint32_t> fill = adjacency_offsets;
+    for (uint32_t i = 0; i < triangles.size(); ++i) {
+        adjacency[fill[triangles[i]]++] = i / 3;
+    }
+
+    // An interior edge shows up once in each direction, in the two triangles sharing it
+    std::vector<Collapse> collapses;
+    for (uint32_t i = 0; i < triangles.size(); i += 3) {
+        for (uint32_t j = 0; j < 3; ++j) {
+            uint32_t a = triangles[i + j];
+            uint32_t b = triangles[i + (j + 1) % 3];
+            if (a > b || (locked[a] && locked[b])) continue;
+
+            double cost_to_b = locked[a] ? std::numeric_limits<double>::max() : get_collapse_cost(quadrics[a], quadrics[b], vertices[b].pos);
+            double cost_to_a = locked[b] ? std::numeric_limits<double>::max() : get_collapse_cost(quadrics[a], quadrics[b], vertices[a].pos);
+            collapses.push_back((cost_to_b <= cost_to_a) ? Collapse{a, b, cost_to_b} : Collapse{b, a, cost_to_a});
+        }
+    }
+    std::sort(collapses.begin(), collapses.end(), [] (const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+    // Most collapses remove two triangles
+    uint32_t collapse_goal = (triangle_count - target_triangle_count + 1) / 2;
+    uint32_t collapse_count = 0;
+    std::vector<uint32_t> remap(vertex_count);
+    std::iota(remap.begin(), remap.end(), 0u);
+    std::vector<uint8_t> touched(vertex_count, 0);
+    for (const auto& collapse : collapses) {
+        if (collapse_count == collapse_goal) break;
+        if (touched[collapse.from] || touched[collapse.to]) continue;
+
+        uint32_t first_adjacent = adjacency_offsets[collapse.from];
+        if (flips_triangle(vertices, triangles, remap, &adjacency[first_adjacent], adjacency_offsets[collapse.from + 1] - first_adjacent,
+                           collapse.from, collapse.to)) {
+            continue;
+        }
+
+        remap[collapse.from] = collapse.to;
+        add_quadric(quadrics[collapse.to], quadrics[collapse.from]);
+        touched[collapse.from] = 1;
+        touched[collapse.to] = 1;
+        max_cost = std::max(max_cost, collapse.cost);
+        ++collapse_count;
+    }
+    if (collapse_count == 0) return 0;
+
+    // The vertex a corner moved from was not a seam, so its texture coordinates pick the side of the new one
+    size_t kept = 0;
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        uint32_t triangle[3];
+        for (size_t j = 0; j < 3; ++j) {
+            triangle[j] = remap[triangles[i + j]];
+            if (triangle[j] != triangles[i + j]) {
+                corners[i + j] = find_closest_member(vertices, welding, triangle[j], vertices[corners[i + j]].tex_coord);
+            }
+        }
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) continue;
+
+        for (size_t j = 0; j < 3; ++j) {
+            triangles[kept + j] = triangle[j];
+            corners[kept + j] = corners[i + j];
+        }
+        kept += 3;
+    }
+    triangles.resize(kept);
+    corners.resize(kept);
+
+    return collapse_count;
+}
+
+std::vector<SimplifiedMesh> build_lod_chain(const Vertex* vertices, uint32_t vertex_count,
+                                            const uint32_t* indices, uint32_t index_count,
+                                            uint32_t level_count, float reduction) {
+    std::vector<SimplifiedMesh> levels;
+    if (level_count == 0 || index_count < 3) return levels;
+
+    // Triangles over the welded vertices, and the vertex every corner is drawn with
+    Welding welding = weld_positions(vertices, vertex_count);
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> corners;
+    triangles.reserve(index_count);
+    corners.reserve(index_count);
+    for (uint32_t i = 0; i + 3 <= index_count; i += 3) {
+        uint32_t a = welding.representatives[indices[i]];
+        uint32_t b = welding.representatives[indices[i + 1]];
+        uint32_t c = welding.representatives[indices[i + 2]];
+        if (a == b || b == c || c == a) continue;
+
+        triangles.insert(triangles.end(), {a, b, c});
+        corners.insert(corners.end(), {indices[i], indices[i + 1], indices[i + 2]});
+    }
+
+    std::vector<uint8_t> locked = find_locked_vertices(welding, triangles, vertex_count);
+
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        const auto& a = vertices[triangles[i]].pos;
+        glm::vec3 normal = glm::cross(vertices[triangles[i + 1]].pos - a, vertices[triangles[i + 2]].pos - a);
+        float length = glm::length(normal);
+        if (length == 0.0f) continue;
+
+        normal /= length;
+        for (size_t j = 0; j < 3; ++j) {
+            add_plane(quadrics[triangles[i + j]], normal, -glm::dot(normal, a), 0.5f * length);
+        }
+    }
+
+    // Each level continues from the one before, so the errors only grow along the chain
+    double max_cost = 0.0;
+    auto previous_triangle_count = static_cast<uint32_t>(triangles.size() / 3);
+    for (uint32_t level = 0; level < level_count; ++level) {
+        auto target_triangle_count = static_cast<uint32_t>(previous_triangle_count * reduction);
+        if (target_triangle_count < min_level_triangle_count) break;
+
+        // A pass that barely gets anywhere means the rest is locked or would fold over
+        while (triangles.size() / 3 > target_triangle_count) {
+            auto triangle_count = static_cast<uint32_t>(triangles.size() / 3);
+            collapse_edges(vertices, welding, locked, quadrics, triangles, corners, target_triangle_count, max_cost);
+            if ((triangle_count - triangles.size() / 3) * 100 < triangle_count) break;
+        }
+
+        auto triangle_count = static_cast<uint32_t>(triangles.size() / 3);
+        if (triangle_count > previous_triangle_count * (1.0f - min_level_reduction)) break;
+
+        SimplifiedMesh simplified;
+        simplified.indices = corners;
+        simplified.error = static_cast<float>(std::sqrt(max_cost));
+        levels.push_back(std::move(simplified));
+        previous_triangle_count = triangle_count;
+    }
+
+    return levels;
+}
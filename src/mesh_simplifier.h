@@ -0,0 +1,42 @@
+#ifndef MESH_SIMPLIFIER_H_INCLUDED
+#define MESH_SIMPLIFIER_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+
+#include "vertex.h"
+
+// A coarser level of detail over the vertices of the full mesh
+struct SimplifiedMesh {
+    std::vector<uint32_t> indices;
+
+    // Area weighted root mean square distance of a collapsed vertex to the planes of the
+    // triangles it has absorbed, the largest of any collapse so far. In model units
+    float error = 0.0f;
+};
+
+// Where a level of detail lies in the index buffer, its ranges and its meshlets, laid out
+// for std430 and read by the culling pass and the task shader
+struct MeshLod {
+    uint32_t first_index;
+    uint32_t index_count;
+    uint32_t first_range;
+    uint32_t range_count;
+    uint32_t first_meshlet;
+    uint32_t meshlet_count;
+
+    // Of the SimplifiedMesh, 0 for the full mesh
+    float error;
+};
+static_assert(sizeof(MeshLod) == 28);
+
+// Builds up to level_count coarser levels with quadric error edge collapses (Garland and
+// Heckbert 1997), each aiming for reduction times the triangles of the level before. Every
+// collapse moves a vertex onto a neighbour, so all levels index into the same vertices.
+// Vertices on an open border or a texture seam never move, and the chain ends early once
+// they keep a level from shrinking noticeably
+std::vector<SimplifiedMesh> build_lod_chain(const Vertex* vertices, uint32_t vertex_count,
+                                            const uint32_t* indices, uint32_t index_count,
+                                            uint32_t level_count, float reduction = 0.5f);
+
+#endif
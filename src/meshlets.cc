@@ -0,0 +1,135 @@
+#include "meshlets.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+// The normal cone follows computeClusterBounds of meshoptimizer
+void compute_meshlet_bounds(const Vertex* vertices, const MeshletData& data, Meshlet& meshlet) {
+    // Centered on the bounding box, like the sphere of the whole model
+    glm::vec3 min_corner(std::numeric_limits<float>::max());
+    glm::vec3 max_corner(std::numeric_limits<float>::lowest());
+    for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+        const auto& position = vertices[data.vertices[meshlet.first_vertex + i]].pos;
+        min_corner = glm::min(min_corner, position);
+        max_corner = glm::max(max_corner, position);
+    }
+
+    glm::vec3 center = (min_corner + max_corner) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+        radius = std::max(radius, glm::distance(center, vertices[data.vertices[meshlet.first_vertex + i]].pos));
+    }
+
+    meshlet.bounding_sphere = glm::vec4(center, radius);
+    meshlet.cone_apex = glm::vec4(center, 0.0f);
+    meshlet.cone_axis_cutoff = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // Counterclockwise triangles face their normal, degenerate ones face nowhere and are skipped
+    std::array<glm::vec3, meshlet_max_triangles> normals;
+    std::array<glm::vec3, meshlet_max_triangles> corners;
+    uint32_t normal_count = 0;
+    glm::vec3 axis(0.0f);
+    for (uint32_t i = 0; i < meshlet.triangle_count; ++i) {
+        uint32_t triangle = data.triangles[meshlet.first_triangle + i];
+        const auto& a = vertices[data.vertices[meshlet.first_vertex + (triangle & 0xff)]].pos;
+        const auto& b = vertices[data.vertices[meshlet.first_vertex + ((triangle >> 8) & 0xff)]].pos;
+        const auto& c = vertices[data.vertices[meshlet.first_vertex + ((triangle >> 16) & 0xff)]].pos;
+
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float area = glm::length(normal);
+        if (area == 0.0f) continue;
+
+        normals[normal_count] = normal / area;
+        corners[normal_count] = a;
+        axis += normals[normal_count];
+        ++normal_count;
+    }
+
+    float axis_length = glm::length(axis);
+    if (axis_length == 0.0f) return;
+    axis /= axis_length;
+
+    float min_dot = 1.0f;
+    for (uint32_t i = 0; i < normal_count; ++i) {
+        min_dot = std::min(min_dot, glm::dot(normals[i], axis));
+    }
+
+    // Normals spread over more than about 84 degrees from the axis, the cone would hardly ever cull
+    if (min_dot <= 0.1f) return;
+
+    // Back from the center along the axis until the apex lies behind the plane of every triangle
+    float max_distance = 0.0f;
+    for (uint32_t i = 0; i < normal_count; ++i) {
+        float distance = glm::dot(center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+        max_distance = std::max(max_distance, distance);
+    }
+
+    // The normals are within acos(min_dot) of the axis, so a view direction within 90 degrees
+    // minus that of the axis sees all of them from behind, cos(90 - a) = sin(a)
+    meshlet.cone_apex = glm::vec4(center - axis * max_distance, 0.0f);
+    meshlet.cone_axis_cutoff = glm::vec4(axis, std::sqrt(1.0f - min_dot * min_dot));
+}
+
+MeshletData build_meshlets(const Vertex* vertices, uint32_t vertex_count, const uint32_t* indices,
+                           const std::vector<IndexRange>& ranges) {
+    MeshletData data;
+
+    constexpr uint8_t unmapped = std::numeric_limits<uint8_t>::max();
+    static_assert(meshlet_max_vertices < unmapped);
+    std::vector<uint8_t> local_indices(vertex_count, unmapped);
+
+    auto finish_meshlet = [&] (Meshlet& meshlet) {
+        for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+            local_indices[data.vertices[meshlet.first_vertex + i]] = unmapped;
+        }
+        compute_meshlet_bounds(vertices, data, meshlet);
+        data.meshlets.push_back(meshlet);
+    };
+
+    for (const auto& range : ranges) {
+        Meshlet meshlet{};
+        meshlet.first_index = range.first_index;
+        meshlet.vertex_offset = range.vertex_offset;
+        meshlet.first_vertex = static_cast<uint32_t>(data.vertices.size());
+        meshlet.first_triangle = static_cast<uint32_t>(data.triangles.size());
+
+        uint32_t end_index = range.first_index + range.index_count;
+        for (uint32_t first = range.first_index; first + 3 <= end_index; first += 3) {
+            // Counts a vertex repeated within the triangle twice, which at worst closes a meshlet early
+            uint32_t new_vertex_count = 0;
+            for (uint32_t i = first; i < first + 3; ++i) {
+                new_vertex_count += (local_indices[range.vertex_offset + indices[i]] == unmapped);
+            }
+
+            if (meshlet.vertex_count + new_vertex_count > meshlet_max_vertices || meshlet.triangle_count == meshlet_max_triangles) {
+                finish_meshlet(meshlet);
+                meshlet = {};
+                meshlet.first_index = first;
+                meshlet.vertex_offset = range.vertex_offset;
+                meshlet.first_vertex = static_cast<uint32_t>(data.vertices.size());
+                meshlet.first_triangle = static_cast<uint32_t>(data.triangles.size());
+            }
+
+            uint32_t triangle = 0;
+            for (uint32_t i = first; i < first + 3; ++i) {
+                uint32_t vertex = range.vertex_offset + indices[i];
+                if (local_indices[vertex] == unmapped) {
+                    local_indices[vertex] = static_cast<uint8_t>(meshlet.vertex_count++);
+                    data.vertices.push_back(vertex);
+                }
+                triangle |= static_cast<uint32_t>(local_indices[vertex]) << (8 * (i - first));
+            }
+            data.triangles.push_back(triangle);
+            meshlet.index_count += 3;
+            ++meshlet.triangle_count;
+        }
+
+        if (meshlet.triangle_count > 0) {
+            finish_meshlet(meshlet);
+        }
+    }
+
+    return data;
+}
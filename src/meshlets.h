@@ -0,0 +1,59 @@
+#ifndef MESHLETS_H_INCLUDED
+#define MESHLETS_H_INCLUDED
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+#include "vertex.h"
+#include "index_ranges.h"
+
+// Well within the output limits of mesh shaders on every vendor. With 124 triangles the 8-bit
+// indices and a primitive count fit three 128 byte blocks of mesh output memory
+constexpr uint32_t meshlet_max_vertices = 64;
+constexpr uint32_t meshlet_max_triangles = 124;
+
+// Laid out for std430, read by the culling pass and by the task and mesh shaders
+struct Meshlet {
+    // Center in model space followed by the radius
+    glm::vec4 bounding_sphere;
+
+    // Every triangle faces away from a camera whose direction to the apex lies within
+    // acos(cutoff) of the axis. A cutoff of 1 means the triangles face too many ways to
+    // ever be culled together
+    glm::vec4 cone_apex;
+    glm::vec4 cone_axis_cutoff;
+
+    // Consecutive triangles of the index buffer, drawn with the vertex offset of their range
+    uint32_t first_index;
+    uint32_t index_count;
+    int32_t vertex_offset;
+
+    // Into MeshletData::vertices and MeshletData::triangles
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    uint32_t first_triangle;
+    uint32_t triangle_count;
+    uint32_t padding;
+};
+static_assert(sizeof(Meshlet) == 80);
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+
+    // Indices into the vertex buffer, the vertex offset of the range already added
+    std::vector<uint32_t> vertices;
+
+    // Three 8-bit indices into the vertices of the meshlet per triangle, in the low 24 bits
+    std::vector<uint32_t> triangles;
+};
+
+// Cuts every range into meshlets of consecutive triangles, starting a new one whenever the
+// next triangle would exceed either limit. The triangle order is already optimized for the
+// vertex cache, so consecutive triangles are close together and share most of their vertices.
+// Indices are relative to the vertex offset of their range, vertex_count spans all ranges
+MeshletData build_meshlets(const Vertex* vertices, uint32_t vertex_count, const uint32_t* indices,
+                           const std::vector<IndexRange>& ranges);
+
+#endif
@@ -0,0 +1,111 @@
+#include "mip_builder.h"
+
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+// Rows per slice below which splitting a level across threads costs more than it saves
+constexpr uint32_t min_rows_per_slice = 16;
+
+// Indexed by linear intensity in 1/65535 steps, fine enough to round to the nearest sRGB value
+constexpr uint32_t linear_table_size = 65536;
+
+std::array<float, 256> make_srgb_to_linear_table() {
+    std::array<float, 256> table;
+    for (int i = 0; i < 256; ++i) {
+        float c = i / 255.0f;
+        table[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return table;
+}
+
+std::vector<uint8_t> make_linear_to_srgb_table() {
+    std::vector<uint8_t> table(linear_table_size);
+    for (uint32_t i = 0; i < linear_table_size; ++i) {
+        float c = static_cast<float>(i) / (linear_table_size - 1);
+        float encoded = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        table[i] = static_cast<uint8_t>(encoded * 255.0f + 0.5f);
+    }
+    return table;
+}
+
+const std::array<float, 256> srgb_to_linear_table = make_srgb_to_linear_table();
+const std::vector<uint8_t> linear_to_srgb_table = make_linear_to_srgb_table();
+
+void encode_row(const float* source, uint8_t* destination, uint32_t width) {
+    for (uint32_t x = 0; x < width; ++x) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            float scaled = std::clamp(source[x * 4 + c], 0.0f, 1.0f) * (linear_table_size - 1) + 0.5f;
+            destination[x * 4 + c] = linear_to_srgb_table[static_cast<uint32_t>(scaled)];
+        }
+        destination[x * 4 + 3] = static_cast<uint8_t>(std::clamp(source[x * 4 + 3], 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+// Level 1 straight from the sRGB source, which is never converted to floats as a whole.
+// Alpha is not gamma encoded, it only moves between 0 to 255 and 0 to 1
+void downsample_srgb_row(const uint8_t* row0, const uint8_t* row1, uint32_t source_width, float* destination, uint32_t width) {
+    for (uint32_t x = 0; x < width; ++x) {
+        uint32_t x0 = std::min(x * 2, source_width - 1) * 4;
+        uint32_t x1 = std::min(x * 2 + 1, source_width - 1) * 4;
+        for (uint32_t c = 0; c < 3; ++c) {
+            destination[x * 4 + c] = (srgb_to_linear_table[row0[x0 + c]] + srgb_to_linear_table[row0[x1 + c]] +
+                                      srgb_to_linear_table[row1[x0 + c]] + srgb_to_linear_table[row1[x1 + c]]) * 0.25f;
+        }
+        destination[x * 4 + 3] = (row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3]) / (4.0f * 255.0f);
+    }
+}
+
+// Averages two rows of the level above into one, odd edges reuse the last row or column like a clamped blit
+void downsample_row(const float* row0, const float* row1, uint32_t source_width, float* destination, uint32_t width) {
+    for (uint32_t x = 0; x < width; ++x) {
+        uint32_t x0 = std::min(x * 2, source_width - 1) * 4;
+        uint32_t x1 = std::min(x * 2 + 1, source_width - 1) * 4;
+        for (uint32_t c = 0; c < 4; ++c) {
+            destination[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+        }
+    }
+}
+
+std::vector<MipLevel> build_mip_chain(const uint8_t* pixels, uint32_t width, uint32_t height, ThreadPool& thread_pool) {
+    auto get_slice_count = [&thread_pool] (uint32_t rows) {
+        return std::clamp(rows / min_rows_per_slice, 1u, thread_pool.get_worker_count() + 1);
+    };
+
+    std::vector<MipLevel> levels;
+    levels.push_back({width, height, std::vector<uint8_t>(pixels, pixels + static_cast<size_t>(width) * height * 4)});
+
+    // Linear texels of the previous level, empty while that is the source
+    std::vector<float> linear;
+    std::vector<float> next_linear;
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        uint32_t source_width = levels.back().width;
+        uint32_t source_height = levels.back().height;
+
+        MipLevel level;
+        level.width = std::max(source_width / 2, 1u);
+        level.height = std::max(source_height / 2, 1u);
+        level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4);
+        next_linear.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+        thread_pool.parallel_for(get_slice_count(level.height), level.height, [&] (uint32_t, size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                size_t y0 = std::min<size_t>(y * 2, source_height - 1);
+                size_t y1 = std::min<size_t>(y * 2 + 1, source_height - 1);
+                float* destination = &next_linear[y * level.width * 4];
+                if (linear.empty()) {
+                    downsample_srgb_row(&pixels[y0 * source_width * 4], &pixels[y1 * source_width * 4], source_width,
+                                        destination, level.width);
+                } else {
+                    downsample_row(&linear[y0 * source_width * 4], &linear[y1 * source_width * 4], source_width,
+                                   destination, level.width);
+                }
+                encode_row(destination, &level.pixels[y * level.width * 4], level.width);
+            }
+        });
+
+        std::swap(linear, next_linear);
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
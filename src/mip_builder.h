@@ -0,0 +1,21 @@
+#ifndef MIP_BUILDER_H_INCLUDED
+#define MIP_BUILDER_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+
+#include "thread_pool.h"
+
+// Tightly packed RGBA8 texels of one mip level
+struct MipLevel {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> pixels;
+};
+
+// Full chain down to 1x1 from sRGB encoded RGBA8 pixels, level 0 is a copy of the source.
+// Each level is a 2x2 box filter of the one above, done in linear space on floats so that
+// no level is built from rounded sRGB values. Rows of a level are split across the thread pool
+std::vector<MipLevel> build_mip_chain(const uint8_t* pixels, uint32_t width, uint32_t height, ThreadPool&);
+
+#endif
@@ -0,0 +1,131 @@
+#include "pipeline_library.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+uint64_t hash_pipeline_key(const PipelineKey& key) {
+    uint64_t hash = static_cast<uint64_t>(key.samples) |
+                    static_cast<uint64_t>(key.polygon_mode) << 8 |
+                    static_cast<uint64_t>(key.depth_only) << 16 |
+                    static_cast<uint64_t>(key.blended) << 17 |
+                    static_cast<uint64_t>(key.mesh_shading) << 18;
+
+    // Finalizer from MurmurHash3, a bijection, so the packing above stays collision free
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+std::string describe_pipeline_key(const PipelineKey& key) {
+    std::string description = std::to_string(static_cast<uint32_t>(key.samples)) + "x MSAA";
+    if (key.polygon_mode == VK_POLYGON_MODE_LINE) description += ", wireframe";
+    if (key.depth_only) description += ", depth only";
+    if (key.blended) description += ", blended";
+    if (key.mesh_shading) description += ", mesh shading";
+    return description;
+}
+
+void PipelineLibrary::init(VkDevice _device, ThreadPool& _thread_pool, Compiler _compiler) {
+    device = _device;
+    thread_pool = &_thread_pool;
+    compiler = std::move(_compiler);
+    stopping = false;
+}
+
+void PipelineLibrary::destroy() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+
+    // Queued jobs still run, but return right away once they see stopping
+    for (auto& [hash, variant] : variants) {
+        if (variant.compilation.valid()) {
+            variant.compilation.wait();
+        }
+    }
+
+    for (auto& [hash, variant] : variants) {
+        if (variant.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, variant.pipeline, nullptr);
+        }
+    }
+    variants.clear();
+}
+
+void PipelineLibrary::insert(const PipelineKey& key, VkPipeline pipeline) {
+    std::lock_guard lock(mutex);
+    auto& variant = variants[hash_pipeline_key(key)];
+    if (variant.pipeline != VK_NULL_HANDLE) {
+        throw std::runtime_error("Failed to insert pipeline variant: " + describe_pipeline_key(key) + " exists already.");
+    }
+    variant.key = key;
+    variant.state = PipelineState::ready;
+    variant.pipeline = pipeline;
+}
+
+void PipelineLibrary::request(const PipelineKey& key) {
+    uint64_t hash = hash_pipeline_key(key);
+    {
+        std::lock_guard lock(mutex);
+        if (stopping || variants.contains(hash)) return;
+
+        auto& variant = variants[hash];
+        variant.key = key;
+    }
+
+    // Submitted without holding the lock, a pool without workers runs the job right here
+    auto compilation = thread_pool->submit([this, hash, key] () { compile(hash, key); });
+
+    std::lock_guard lock(mutex);
+    variants[hash].compilation = std::move(compilation);
+}
+
+PipelineState PipelineLibrary::find(const PipelineKey& key, VkPipeline& pipeline) {
+    std::lock_guard lock(mutex);
+    auto it = variants.find(hash_pipeline_key(key));
+    if (it == variants.end()) {
+        return PipelineState::missing;
+    }
+
+    if (it->second.state == PipelineState::ready) {
+        pipeline = it->second.pipeline;
+    }
+    return it->second.state;
+}
+
+uint32_t PipelineLibrary::get_ready_count() {
+    std::lock_guard lock(mutex);
+    uint32_t ready_count = 0;
+    for (const auto& [hash, variant] : variants) {
+        ready_count += (variant.state == PipelineState::ready);
+    }
+    return ready_count;
+}
+
+void PipelineLibrary::compile(uint64_t hash, PipelineKey key) {
+    {
+        std::lock_guard lock(mutex);
+        if (stopping) {
+            variants[hash].state = PipelineState::failed;
+            return;
+        }
+    }
+
+    // Exceptions must not escape the worker, a failed variant is simply never used
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    try {
+        pipeline = compiler(key);
+    } catch (const std::exception& e) {
+        std::cerr << "Pipeline variant " << describe_pipeline_key(key) << ": " << e.what() << std::endl;
+    }
+
+    std::lock_guard lock(mutex);
+    auto& variant = variants[hash];
+    variant.pipeline = pipeline;
+    variant.state = (pipeline != VK_NULL_HANDLE) ? PipelineState::ready : PipelineState::failed;
+}
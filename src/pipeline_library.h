@@ -0,0 +1,87 @@
+#ifndef PIPELINE_LIBRARY_H_INCLUDED
+#define PIPELINE_LIBRARY_H_INCLUDED
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+#include "thread_pool.h"
+
+// Fixed function state that differs between variants of the graphics pipeline
+struct PipelineKey {
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+    bool depth_only = false;
+    bool blended = false;
+
+    // Task and mesh shaders in place of vertex input and the vertex shader
+    bool mesh_shading = false;
+
+    bool operator== (const PipelineKey&) const = default;
+};
+
+// Packs the fields into disjoint bits before mixing, so distinct keys never share a hash
+uint64_t hash_pipeline_key(const PipelineKey&);
+std::string describe_pipeline_key(const PipelineKey&);
+
+enum class PipelineState {
+    missing,
+    compiling,
+    ready,
+    failed,
+};
+
+// Graphics pipeline variants keyed by a hash of their state. Variants are compiled on the
+// thread pool and looked up without ever waiting for a compilation to finish, so the
+// frame loop keeps drawing with the pipeline it has until the one it wants is ready
+class PipelineLibrary {
+public:
+    // Called on worker threads, must only read state that outlives the library
+    using Compiler = std::function<VkPipeline(const PipelineKey&)>;
+
+    PipelineLibrary() = default;
+
+    PipelineLibrary(const PipelineLibrary&) = delete;
+    PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+
+    void init(VkDevice, ThreadPool&, Compiler);
+
+    // Skips compilations that have not started, waits for running ones and destroys every pipeline
+    void destroy();
+
+    // Takes ownership of a pipeline compiled by the caller
+    void insert(const PipelineKey&, VkPipeline);
+
+    // Queues the variant for compilation unless it is known already
+    void request(const PipelineKey&);
+
+    // Never blocks, pipeline is only written when the variant is ready
+    PipelineState find(const PipelineKey&, VkPipeline& pipeline);
+
+    uint32_t get_ready_count();
+
+private:
+    struct Variant {
+        PipelineKey key;
+        PipelineState state = PipelineState::compiling;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::future<void> compilation;
+    };
+
+    void compile(uint64_t hash, PipelineKey);
+
+    VkDevice device = VK_NULL_HANDLE;
+    ThreadPool* thread_pool = nullptr;
+    Compiler compiler;
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Variant> variants;
+    bool stopping = false;
+};
+
+#endif
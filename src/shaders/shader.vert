@@ -1,7 +1,12 @@
 #version 450
+// The compact layout stores positions and texture coordinates as 16-bit normalized
+// integers within the bounds of the mesh, and no color
 layout (location = 0) in vec3 in_position;
+#ifndef COMPACT_VERTEX_LAYOUT
 layout (location = 1) in vec3 in_color;
+#endif
 layout (location = 2) in vec2 in_tex_coord;
+layout (location = 3) in mat4 in_instance_model;
 
 layout (location = 0) out vec3 frag_color;
 layout (location = 1) out vec2 frag_tex_coord;
@@ -12,8 +17,24 @@ layout (binding = 0) uniform UniformBufferObject {
     mat4 projection;
 } ubo;
 
+// Per draw placement, xyz is an offset and w a uniform scale. The dequantization of the
+// bound mesh follows, identity for the full layout
+layout (push_constant) uniform DrawPushConstants {
+    vec4 offset_scale;
+    vec4 position_scale;
+    vec4 position_offset;
+    vec4 tex_coord_scale_offset;
+} draw;
+
 void main() {
-    gl_Position = ubo.projection * ubo.view * ubo.model * vec4(in_position, 1.0);
+    vec3 model_position = in_position * draw.position_scale.xyz + draw.position_offset.xyz;
+    vec3 instance_position = (in_instance_model * vec4(model_position, 1.0)).xyz;
+    vec3 position = instance_position * draw.offset_scale.w + draw.offset_scale.xyz;
+    gl_Position = ubo.projection * ubo.view * ubo.model * vec4(position, 1.0);
+#ifdef COMPACT_VERTEX_LAYOUT
+    frag_color = vec3(1.0);
+#else
     frag_color = in_color;
-    frag_tex_coord = in_tex_coord;
+#endif
+    frag_tex_coord = in_tex_coord * draw.tex_coord_scale_offset.xy + draw.tex_coord_scale_offset.zw;
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "staging_ring.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void StagingRing::init(VkDevice _device, MemoryAllocator& _allocator, VkDeviceSize _capacity) {
+    device = _device;
+    allocator = &_allocator;
+    capacity = _capacity;
+
+    VkBufferCreateInfo buffer_create_info{};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = capacity;
+    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create staging ring buffer.");
+    }
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memory_requirements);
+
+    allocation = allocator->allocate(memory_requirements,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to bind staging ring memory.");
+    }
+}
+
+void StagingRing::destroy() {
+    if (buffer == VK_NULL_HANDLE) return;
+
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator->free(allocation);
+    buffer = VK_NULL_HANDLE;
+
+    head = 0;
+    used_bytes = 0;
+    unsubmitted_bytes = 0;
+    pending_submissions.clear();
+}
+
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, StagingRegion& region) {
+    VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+
+    // Regions are contiguous, skip the tail of the buffer if the request does not fit before it
+    if (offset + size > capacity) {
+        offset = 0;
+    }
+
+    VkDeviceSize consumed = (offset >= head) ? offset - head + size : capacity - head + size;
+    if (size > capacity || used_bytes + consumed > capacity) {
+        return false;
+    }
+
+    head = offset + size;
+    used_bytes += consumed;
+    unsubmitted_bytes += consumed;
+    peak_used_bytes = std::max(peak_used_bytes, used_bytes);
+
+    region.buffer = buffer;
+    region.offset = offset;
+    region.size = size;
+    region.mapped = static_cast<char*>(allocation.mapped) + offset;
+    return true;
+}
+
+void StagingRing::submit(uint64_t submission) {
+    if (unsubmitted_bytes == 0) return;
+
+    pending_submissions.push_back({submission, unsubmitted_bytes});
+    unsubmitted_bytes = 0;
+}
+
+void StagingRing::retire(uint64_t submission) {
+    while (!pending_submissions.empty() && pending_submissions.front().submission <= submission) {
+        used_bytes -= pending_submissions.front().size;
+        pending_submissions.pop_front();
+    }
+
+    // Start over from the beginning once drained so that large uploads do not have to wrap
+    if (used_bytes == 0) {
+        head = 0;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef STAGING_RING_H_INCLUDED
+#define STAGING_RING_H_INCLUDED
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+
+#include "memory_allocator.h"
+
+// A piece of the staging ring, valid until the submission that reads it has retired
+struct StagingRegion {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+};
+
+// One persistently mapped host visible buffer that uploads are carved out of in FIFO order.
+// Regions are tagged with the id of the submission that reads them and handed back
+// once that submission is known to have completed
+class StagingRing {
+public:
+    StagingRing() = default;
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    void init(VkDevice, MemoryAllocator&, VkDeviceSize capacity);
+    void destroy();
+
+    // Returns false when the ring has no room left until earlier submissions retire
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, StagingRegion&);
+
+    // Tags everything allocated since the previous call with the given submission id,
+    // ids must be increasing
+    void submit(uint64_t submission);
+
+    // Reclaims the regions of every submission up to and including the given one
+    void retire(uint64_t submission);
+
+    VkDeviceSize get_capacity() const { return capacity; }
+    VkDeviceSize get_used_bytes() const { return used_bytes; }
+    VkDeviceSize get_peak_used_bytes() const { return peak_used_bytes; }
+
+private:
+    struct PendingSubmission {
+        uint64_t submission;
+        VkDeviceSize size;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation allocation;
+
+    VkDeviceSize capacity = 0;
+    VkDeviceSize head = 0;
+
+    // Includes alignment padding and the space skipped when wrapping around
+    VkDeviceSize used_bytes = 0;
+    VkDeviceSize unsubmitted_bytes = 0;
+    VkDeviceSize peak_used_bytes = 0;
+    std::deque<PendingSubmission> pending_submissions;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "texture_cache.h"
+#include "bc7_encoder.h"
+
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+constexpr char texture_cache_magic[4] = {'L', 'V', 'T', 'C'};
+
+uint64_t get_texture_cache_level_size(TextureCacheFormat format, uint32_t width, uint32_t height) {
+    if (format == TextureCacheFormat::bc7_srgb) {
+        return get_bc7_size(width, height);
+    }
+    return static_cast<uint64_t>(width) * height * 4;
+}
+
+bool TextureCache::load(const std::string& path, uint64_t source_hash, TextureCacheFormat format) {
+    close();
+    if (!std::filesystem::exists(path)) return false;
+
+    file = MappedFile(path);
+    if (file.get_size() < sizeof(TextureCacheHeader)) {
+        close();
+        return false;
+    }
+
+    auto header = reinterpret_cast<const TextureCacheHeader*>(file.get_data());
+    uint64_t index_end = sizeof(TextureCacheHeader) + static_cast<uint64_t>(header->level_count) * sizeof(TextureCacheLevelIndex);
+    uint32_t max_level_count = static_cast<uint32_t>(std::bit_width(std::max(header->width, header->height)));
+    bool valid = std::memcmp(header->magic, texture_cache_magic, sizeof(texture_cache_magic)) == 0 &&
+                 header->version == texture_cache_version &&
+                 header->source_hash == source_hash &&
+                 header->format == format &&
+                 header->width > 0 && header->height > 0 &&
+                 header->level_count > 0 && header->level_count <= max_level_count &&
+                 file.get_size() >= index_end;
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    auto level_index = reinterpret_cast<const TextureCacheLevelIndex*>(file.get_data() + sizeof(TextureCacheHeader));
+    uint32_t width = header->width;
+    uint32_t height = header->height;
+    for (uint32_t i = 0; i < header->level_count; ++i) {
+        const auto& entry = level_index[i];
+        // Every level has to hold exactly the texels of its extent, or its copy region would not match the data
+        if (entry.offset < index_end || entry.offset > file.get_size() || entry.size > file.get_size() - entry.offset ||
+            entry.size != get_texture_cache_level_size(format, width, height)) {
+            close();
+            return false;
+        }
+
+        levels.push_back({width, height, file.get_data() + entry.offset, entry.size});
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+
+    return true;
+}
+
+void TextureCache::close() {
+    file.close();
+    levels.clear();
+}
+
+void TextureCache::write(const std::string& path, uint64_t source_hash, TextureCacheFormat format,
+                         const std::vector<TextureLevel>& levels) {
+    TextureCacheHeader cache_header{};
+    std::memcpy(cache_header.magic, texture_cache_magic, sizeof(texture_cache_magic));
+    cache_header.version = texture_cache_version;
+    cache_header.source_hash = source_hash;
+    cache_header.format = format;
+    cache_header.width = levels.front().width;
+    cache_header.height = levels.front().height;
+    cache_header.level_count = static_cast<uint32_t>(levels.size());
+
+    std::vector<TextureCacheLevelIndex> level_index(levels.size());
+    uint64_t offset = sizeof(TextureCacheHeader) + levels.size() * sizeof(TextureCacheLevelIndex);
+    for (size_t i = 0; i < levels.size(); ++i) {
+        level_index[i].offset = offset;
+        level_index[i].size = levels[i].size;
+        offset += levels[i].size;
+    }
+
+    // Written next to the destination and renamed over it, so a crash never leaves a truncated cache
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream cache_file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!cache_file.is_open()) {
+            throw std::runtime_error("Failed to open: " + temporary_path);
+        }
+
+        cache_file.write(reinterpret_cast<const char*>(&cache_header), sizeof(cache_header));
+        cache_file.write(reinterpret_cast<const char*>(level_index.data()),
+                         static_cast<std::streamsize>(level_index.size() * sizeof(TextureCacheLevelIndex)));
+        for (const auto& level : levels) {
+            cache_file.write(static_cast<const char*>(level.data), static_cast<std::streamsize>(level.size));
+        }
+        if (!cache_file) {
+            throw std::runtime_error("Failed to write: " + temporary_path);
+        }
+    }
+
+    std::filesystem::rename(temporary_path, path);
+}
@@ -0,0 +1,61 @@
+#ifndef TEXTURE_CACHE_H_INCLUDED
+#define TEXTURE_CACHE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "mapped_file.h"
+
+// Bump whenever the layout or the encoding that produces the cached data changes
+constexpr uint32_t texture_cache_version = 2;
+
+enum class TextureCacheFormat : uint32_t {
+    rgba8_srgb = 1,
+    bc7_srgb = 2,
+};
+
+// Laid out like a KTX2 file: the header, then one TextureCacheLevelIndex per mip level
+// starting with the largest, then the level data at the offsets the index gives
+struct TextureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    TextureCacheFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+};
+
+struct TextureCacheLevelIndex {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Encoded texels of one mip level
+struct TextureLevel {
+    uint32_t width;
+    uint32_t height;
+    const void* data;
+    uint64_t size;
+};
+
+// Transcoded textures with their whole mip chain, read straight out of a memory mapped cache file
+class TextureCache {
+public:
+    // Returns false if the cache is missing, corrupt, in another format or was built from a different source
+    bool load(const std::string& path, uint64_t source_hash, TextureCacheFormat);
+    void close();
+
+    static void write(const std::string& path, uint64_t source_hash, TextureCacheFormat,
+                      const std::vector<TextureLevel>& levels);
+
+    // Level data points into the mapping and stays valid until the cache is closed
+    const std::vector<TextureLevel>& get_levels() const { return levels; }
+
+private:
+    MappedFile file;
+    std::vector<TextureLevel> levels;
+};
+
+#endif
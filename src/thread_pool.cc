@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32_t worker_count) {
+    if (worker_count == 0) {
+        worker_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    job_available.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> job) {
+    auto task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+    auto future = task->get_future();
+
+    // Without workers the job runs right away on the calling thread
+    if (workers.empty()) {
+        (*task)();
+        return future;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        jobs.emplace_back([task] () { (*task)(); });
+    }
+    job_available.notify_one();
+    return future;
+}
+
+void ThreadPool::parallel_for(uint32_t slice_count, size_t count,
+                              const std::function<void(uint32_t slice, size_t begin, size_t end)>& task) {
+    struct SharedState {
+        std::atomic<uint32_t> next_slice = 0;
+        std::atomic<uint32_t> remaining_slices;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<SharedState>();
+    state->remaining_slices = slice_count;
+
+    // Slices are claimed rather than assigned, whoever gets to the counter first runs the next one
+    auto run_slices = [state, slice_count, count, &task] () {
+        for (uint32_t slice = state->next_slice++; slice < slice_count; slice = state->next_slice++) {
+            task(slice, count * slice / slice_count, count * (slice + 1) / slice_count);
+            if (--state->remaining_slices == 0) {
+                std::lock_guard lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    uint32_t helper_count = std::min<uint32_t>(get_worker_count(), slice_count > 0 ? slice_count - 1 : 0);
+    if (helper_count > 0) {
+        {
+            std::lock_guard lock(mutex);
+            for (uint32_t i = 0; i < helper_count; ++i) {
+                jobs.emplace_back(run_slices);
+            }
+        }
+        job_available.notify_all();
+    }
+
+    run_slices();
+
+    // Helpers that start after all slices are claimed return without touching task
+    std::unique_lock lock(state->mutex);
+    state->done.wait(lock, [&] () { return state->remaining_slices == 0; });
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(mutex);
+            job_available.wait(lock, [this] () { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty()) return;
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
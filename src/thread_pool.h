@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+// Fixed set of worker threads fed from a single FIFO job queue
+class ThreadPool {
+public:
+    // A worker_count of 0 uses one worker per hardware thread besides the calling one
+    explicit ThreadPool(uint32_t worker_count = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    uint32_t get_worker_count() const { return static_cast<uint32_t>(workers.size()); }
+
+    std::future<void> submit(std::function<void()> job);
+
+    // Splits [0, count) into slice_count contiguous ranges and calls task(slice, begin, end) once per
+    // slice, every slice is called even if its range is empty. The calling thread works through
+    // slices too, so this never waits on workers that are busy with other jobs
+    void parallel_for(uint32_t slice_count, size_t count,
+                      const std::function<void(uint32_t slice, size_t begin, size_t end)>& task);
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable job_available;
+    bool stopping = false;
+};
+
+#endif
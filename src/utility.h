@@ -9,68 +9,55 @@
 #include <iomanip>
 #include <limits>
 #include <array>
-
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <cstring>
 
 #include "application.h"
+#include "vertex.h"
 
 #define PREFERRED_DEVICE_TYPE VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU
 
-struct Vertex {
-    glm::vec3 pos;
-    glm::vec3 color;
-    glm::vec2 tex_coord;
-
-    bool operator== (const Vertex& other) const {
-        return (pos == other.pos) && (color == other.color) && (tex_coord == other.tex_coord);
-    }
-
-    static auto get_binding_description() {
-        VkVertexInputBindingDescription binding_description{};
-        binding_description.binding = 0;
-        binding_description.stride = sizeof(Vertex);
-        binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-        return binding_description;
-    }
-
-    static auto get_attribute_description() {
-        std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions;
-
-        attribute_descriptions[0].binding = 0;
-        attribute_descriptions[0].location = 0;
-        attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[0].offset = offsetof(Vertex, pos);
-
-        attribute_descriptions[1].binding = 0;
-        attribute_descriptions[1].location = 1;
-        attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attribute_descriptions[1].offset = offsetof(Vertex, color);
-
-        attribute_descriptions[2].binding = 0;
-        attribute_descriptions[2].location = 2;
-        attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-        attribute_descriptions[2].offset = offsetof(Vertex, tex_coord);
+struct DrawPushConstants {
+    glm::vec4 offset_scale;
+};
 
-        return attribute_descriptions;
-    }
+// Pushed behind DrawPushConstants whenever a mesh is bound, undoes its vertex quantization.
+// The task shader picks levels of detail by the bounding sphere, center followed by radius
+struct MeshPushConstants {
+    glm::vec4 position_scale;
+    glm::vec4 position_offset;
+    glm::vec4 tex_coord_scale_offset;
+    glm::vec4 bounding_sphere;
 };
 
-namespace std {
-    template<> struct hash<Vertex> {
-        size_t operator() (const Vertex& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^
-            (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^ 
-            (hash<glm::vec2>()(vertex.tex_coord) << 1);
-        }
-    };
+MeshPushConstants get_mesh_push_constants(const VertexQuantization& quantization) {
+    MeshPushConstants push_constants{};
+    push_constants.position_scale = glm::vec4(quantization.position_scale, 0.0f);
+    push_constants.position_offset = glm::vec4(quantization.position_offset, 0.0f);
+    push_constants.tex_coord_scale_offset = glm::vec4(quantization.tex_coord_scale.x, quantization.tex_coord_scale.y,
+                                                      quantization.tex_coord_offset.x, quantization.tex_coord_offset.y);
+    return push_constants;
 }
 
+struct CullPushConstants {
+    glm::vec4 bounding_sphere;
+    uint32_t range_count;
+    uint32_t instance_count;
+    uint32_t draw_count;
+    uint32_t meshlet_count;
+};
+
 struct UniformBufferObject {
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 projection;
+
+    // Culling happens before model is applied. The planes of the frustum in that space point
+    // inwards and are normalized, the camera position has w = 1
+    glm::vec4 frustum_planes[6];
+    glm::vec4 camera_position;
+
+    // Largest error of a level of detail once projected, in normalized device coordinates
+    float lod_threshold;
 };
 
 template<typename T>
@@ -135,10 +122,14 @@ bool Application::is_suitable_device(VkPhysicalDevice _device) {
     bool flag = true;
 
     auto queue_family_indices = find_queue_families(_device);
-    flag &= queue_family_indices.is_complete();
+    if (settings.headless) {
+        flag &= queue_family_indices.graphics_family.has_value();
+    } else {
+        flag &= queue_family_indices.is_complete();
+    }
     flag &= check_device_extension_support(_device);
 
-    if (flag) {
+    if (flag && !settings.headless) {
         auto swap_chain_support_details = query_swap_chain_support(_device);
         flag &= !swap_chain_support_details.formats.empty();
         flag &= !swap_chain_support_details.present_modes.empty();
@@ -148,16 +139,70 @@ bool Application::is_suitable_device(VkPhysicalDevice _device) {
     vkGetPhysicalDeviceFeatures(_device, &supported_features);
     flag &= static_cast<bool>(supported_features.samplerAnisotropy);
 
+    // Frame synchronization is built on timeline semaphores
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_device, &properties);
+    flag &= (properties.apiVersion >= VK_API_VERSION_1_2);
+    if (flag) {
+        VkPhysicalDeviceVulkan12Features vulkan12_features{};
+        vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan12_features;
+        vkGetPhysicalDeviceFeatures2(_device, &features);
+        flag &= static_cast<bool>(vulkan12_features.timelineSemaphore);
+    }
+
     return flag;
 }
 
+bool Application::supports_dynamic_rendering(VkPhysicalDevice _device) {
+    uint32_t extension_count;
+    vkEnumerateDeviceExtensionProperties(_device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> available_extesions(extension_count);
+    vkEnumerateDeviceExtensionProperties(_device, nullptr, &extension_count, available_extesions.data());
+
+    bool extension_found = std::any_of(available_extesions.begin(), available_extesions.end(), [] (const auto& extension) {
+        return std::strcmp(extension.extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0;
+    });
+    if (!extension_found) return false;
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_features{};
+    dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &dynamic_rendering_features;
+    vkGetPhysicalDeviceFeatures2(_device, &features);
+    return dynamic_rendering_features.dynamicRendering;
+}
+
+bool Application::supports_mesh_shading(VkPhysicalDevice _device) {
+    uint32_t extension_count;
+    vkEnumerateDeviceExtensionProperties(_device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> available_extesions(extension_count);
+    vkEnumerateDeviceExtensionProperties(_device, nullptr, &extension_count, available_extesions.data());
+
+    bool extension_found = std::any_of(available_extesions.begin(), available_extesions.end(), [] (const auto& extension) {
+        return std::strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0;
+    });
+    if (!extension_found) return false;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{};
+    mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &mesh_shader_features;
+    vkGetPhysicalDeviceFeatures2(_device, &features);
+    return mesh_shader_features.taskShader && mesh_shader_features.meshShader;
+}
+
 bool Application::check_device_extension_support(VkPhysicalDevice _device) {
     uint32_t extension_count;
     vkEnumerateDeviceExtensionProperties(_device, nullptr, &extension_count, nullptr);
     std::vector<VkExtensionProperties> available_extesions(extension_count);
     vkEnumerateDeviceExtensionProperties(_device, nullptr, &extension_count, available_extesions.data());
 
-    for (auto requested_extension : required_device_extensions) {
+    for (auto requested_extension : get_required_device_extensions()) {
         std::string requested_extension_str = requested_extension;
         bool extension_found = std::any_of(available_extesions.begin(), available_extesions.end(), [=] (const auto& extension) {
             return (requested_extension_str == extension.extensionName);
@@ -223,11 +268,28 @@ VkSurfaceFormatKHR Application::choose_swap_surface_format(const std::vector<VkS
     return formats.front();
 }
 
+const char* get_present_mode_name(VkPresentModeKHR present_mode) {
+    switch (present_mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+        default: return "unknown";
+    }
+}
+
 VkPresentModeKHR Application::choose_swap_present_mode(const std::vector<VkPresentModeKHR>& present_modes) {
-    auto it = std::find_if(present_modes.begin(), present_modes.end(), [] (const auto& present_mode) {
-        return (present_mode == VK_PRESENT_MODE_MAILBOX_KHR);
+    auto it = std::find_if(present_modes.begin(), present_modes.end(), [this] (const auto& present_mode) {
+        return (present_mode == settings.present_mode);
     });
     if (it != present_modes.end()) return *it;
+
+    // FIFO is the only mode every implementation has to support. Swap chains recreated on resize
+    // fall back without repeating the warning
+    if (settings.present_mode != VK_PRESENT_MODE_FIFO_KHR && !present_mode_fallback_reported) {
+        std::cerr << "Present mode " << get_present_mode_name(settings.present_mode) << " is not supported, using fifo\n";
+        present_mode_fallback_reported = true;
+    }
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -250,25 +312,14 @@ VkExtent2D Application::choose_swap_extent(const VkSurfaceCapabilitiesKHR& capab
     }
 }
 
-std::vector<char> read_file(const std::string& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open: " + filename);
-    }
+VkShaderModule Application::create_shader_module(const std::string& path) {
+    // Mappings start on a page boundary, which satisfies the alignment pCode needs
+    MappedFile code(path);
 
-    size_t filesize = (size_t) file.tellg();
-    std::vector<char> buffer(filesize);
-    file.seekg(0);
-    file.read(buffer.data(), filesize);
-    file.close();
-    return buffer;
-}
-
-VkShaderModule Application::create_shader_module(const std::vector<char>& code) {
     VkShaderModuleCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    create_info.codeSize = code.size();
-    create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    create_info.codeSize = code.get_size();
+    create_info.pCode = reinterpret_cast<const uint32_t*>(code.get_data());
 
     VkShaderModule shader_module;
     if (vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS) {
@@ -278,28 +329,21 @@ VkShaderModule Application::create_shader_module(const std::vector<char>& code)
     return shader_module;
 }
 
-uint32_t Application::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memory_properties;
-    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
-    
-    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
-        if ((type_filter & (1 << i)) && 
-            (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+bool Application::is_format_supported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+    if (tiling == VK_IMAGE_TILING_LINEAR) {
+        return (properties.linearTilingFeatures & features) == features;
+    } else if (tiling == VK_IMAGE_TILING_OPTIMAL) {
+        return (properties.optimalTilingFeatures & features) == features;
     }
-
-    throw std::runtime_error("Failed to find suitable memory type.");
+    return false;
 }
 
 VkFormat Application::find_supported_format(const std::vector<VkFormat>& candidates,
                                             VkImageTiling tiling, VkFormatFeatureFlags features) {
     for (auto format : candidates) {
-        VkFormatProperties properties;
-        vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
-        if (tiling == VK_IMAGE_TILING_LINEAR && (properties.linearTilingFeatures & features) == features) {
-            return format;
-        } else if (tiling == VK_IMAGE_TILING_OPTIMAL && (properties.optimalTilingFeatures & features) == features) {
+        if (is_format_supported(format, tiling, features)) {
             return format;
         }
     }
@@ -314,6 +358,24 @@ VkFormat Application::find_depth_format() {
     );
 }
 
+// Drivers reject or silently ignore data from another device or driver version, check it up front
+bool is_pipeline_cache_compatible(const char* data, size_t size, const VkPhysicalDeviceProperties& properties) {
+    constexpr size_t header_size = 16 + VK_UUID_SIZE;
+    if (size < header_size) return false;
+
+    uint32_t header_length, header_version, vendor_id, device_id;
+    std::memcpy(&header_length, data + 0, sizeof(uint32_t));
+    std::memcpy(&header_version, data + 4, sizeof(uint32_t));
+    std::memcpy(&vendor_id, data + 8, sizeof(uint32_t));
+    std::memcpy(&device_id, data + 12, sizeof(uint32_t));
+
+    return header_length >= header_size && header_length <= size &&
+           header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           vendor_id == properties.vendorID &&
+           device_id == properties.deviceID &&
+           std::memcmp(data + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
 bool has_stencil_component(VkFormat format) {
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
@@ -0,0 +1,86 @@
+#ifndef VERTEX_H_INCLUDED
+#define VERTEX_H_INCLUDED
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+
+// Vertex as loaded and processed on the CPU, vertex_layout.h converts it for the vertex buffer
+struct Vertex {
+    glm::vec3 pos;
+    glm::vec3 color;
+    glm::vec2 tex_coord;
+
+    bool operator== (const Vertex& other) const {
+        return (pos == other.pos) && (color == other.color) && (tex_coord == other.tex_coord);
+    }
+};
+
+// Per-instance data, read from a second vertex buffer advanced once per instance
+struct InstanceData {
+    glm::mat4 model;
+
+    static auto get_binding_description() {
+        VkVertexInputBindingDescription binding_description{};
+        binding_description.binding = 1;
+        binding_description.stride = sizeof(InstanceData);
+        binding_description.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return binding_description;
+    }
+
+    // A mat4 attribute takes up one location per column
+    static auto get_attribute_description() {
+        std::array<VkVertexInputAttributeDescription, 4> attribute_descriptions;
+
+        for (uint32_t i = 0; i < 4; ++i) {
+            attribute_descriptions[i].binding = 1;
+            attribute_descriptions[i].location = 3 + i;
+            attribute_descriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attribute_descriptions[i].offset = offsetof(InstanceData, model) + i * sizeof(glm::vec4);
+        }
+
+        return attribute_descriptions;
+    }
+};
+
+// Hashes the bit patterns of all components, so mirrored coordinates that only differ
+// in sign do not collide. -0.0 is folded into 0.0 because the two compare equal
+inline uint64_t hash_vertex(const Vertex& vertex) {
+    const float components[] = {
+        vertex.pos.x, vertex.pos.y, vertex.pos.z,
+        vertex.color.x, vertex.color.y, vertex.color.z,
+        vertex.tex_coord.x, vertex.tex_coord.y,
+    };
+
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+    for (float component : components) {
+        uint32_t bits = 0;
+        if (component != 0.0f) {
+            std::memcpy(&bits, &component, sizeof(bits));
+        }
+        hash = (hash ^ bits) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+
+    // Finalizer from MurmurHash3, spreads the entropy into the high bits as well
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+namespace std {
+    template<> struct hash<Vertex> {
+        size_t operator() (const Vertex& vertex) const {
+            return static_cast<size_t>(hash_vertex(vertex));
+        }
+    };
+}
+
+#endif
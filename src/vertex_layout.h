@@ -0,0 +1,191 @@
+#ifndef VERTEX_LAYOUT_H_INCLUDED
+#define VERTEX_LAYOUT_H_INCLUDED
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "vertex.h"
+
+// Maps 16-bit normalized components back into the bounds of the mesh, value = unorm * scale + offset
+struct VertexQuantization {
+    glm::vec3 position_scale = glm::vec3(1.0f);
+    glm::vec3 position_offset = glm::vec3(0.0f);
+    glm::vec2 tex_coord_scale = glm::vec2(1.0f);
+    glm::vec2 tex_coord_offset = glm::vec2(0.0f);
+};
+
+// Bounding boxes of the positions and texture coordinates. A flat axis keeps a scale of 1,
+// every value on it then quantizes to 0 and comes back exactly
+inline VertexQuantization compute_vertex_quantization(const Vertex* vertices, uint32_t vertex_count) {
+    glm::vec3 min_position(std::numeric_limits<float>::max());
+    glm::vec3 max_position(std::numeric_limits<float>::lowest());
+    glm::vec2 min_tex_coord(std::numeric_limits<float>::max());
+    glm::vec2 max_tex_coord(std::numeric_limits<float>::lowest());
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+        min_position = glm::min(min_position, vertices[i].pos);
+        max_position = glm::max(max_position, vertices[i].pos);
+        min_tex_coord = glm::min(min_tex_coord, vertices[i].tex_coord);
+        max_tex_coord = glm::max(max_tex_coord, vertices[i].tex_coord);
+    }
+
+    VertexQuantization quantization;
+    if (vertex_count == 0) return quantization;
+
+    for (int i = 0; i < 3; ++i) {
+        float extent = max_position[i] - min_position[i];
+        quantization.position_scale[i] = (extent > 0.0f) ? extent : 1.0f;
+        quantization.position_offset[i] = min_position[i];
+    }
+    for (int i = 0; i < 2; ++i) {
+        float extent = max_tex_coord[i] - min_tex_coord[i];
+        quantization.tex_coord_scale[i] = (extent > 0.0f) ? extent : 1.0f;
+        quantization.tex_coord_offset[i] = min_tex_coord[i];
+    }
+    return quantization;
+}
+
+inline uint16_t quantize_unorm16(float value, float offset, float scale) {
+    float normalized = std::clamp((value - offset) / scale, 0.0f, 1.0f);
+    return static_cast<uint16_t>(std::lround(normalized * 65535.0f));
+}
+
+// Attributes of a vertex layout. Each one names its shader location and the format the
+// GPU reads it in, and writes its size bytes for a vertex
+struct PositionAttribute {
+    static constexpr uint32_t location = 0;
+    static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+    static constexpr uint32_t size = 3 * sizeof(float);
+    static constexpr bool quantized = false;
+
+    static void encode(const Vertex& vertex, const VertexQuantization&, uint8_t* destination) {
+        const float components[] = {vertex.pos.x, vertex.pos.y, vertex.pos.z};
+        std::memcpy(destination, components, size);
+    }
+};
+
+// Padded to four components, three component 16-bit formats are rarely supported for vertex input
+struct QuantizedPositionAttribute {
+    static constexpr uint32_t location = 0;
+    static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_UNORM;
+    static constexpr uint32_t size = 4 * sizeof(uint16_t);
+    static constexpr bool quantized = true;
+
+    static void encode(const Vertex& vertex, const VertexQuantization& quantization, uint8_t* destination) {
+        uint16_t components[4] = {};
+        for (int i = 0; i < 3; ++i) {
+            components[i] = quantize_unorm16(vertex.pos[i], quantization.position_offset[i], quantization.position_scale[i]);
+        }
+        std::memcpy(destination, components, size);
+    }
+};
+
+struct ColorAttribute {
+    static constexpr uint32_t location = 1;
+    static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+    static constexpr uint32_t size = 3 * sizeof(float);
+    static constexpr bool quantized = false;
+
+    static void encode(const Vertex& vertex, const VertexQuantization&, uint8_t* destination) {
+        const float components[] = {vertex.color.x, vertex.color.y, vertex.color.z};
+        std::memcpy(destination, components, size);
+    }
+};
+
+struct TexCoordAttribute {
+    static constexpr uint32_t location = 2;
+    static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+    static constexpr uint32_t size = 2 * sizeof(float);
+    static constexpr bool quantized = false;
+
+    static void encode(const Vertex& vertex, const VertexQuantization&, uint8_t* destination) {
+        const float components[] = {vertex.tex_coord.x, vertex.tex_coord.y};
+        std::memcpy(destination, components, size);
+    }
+};
+
+// 16-bit normalized rather than half floats, which are only accurate to half a texel of a
+// 1024 texel wide texture near 1
+struct QuantizedTexCoordAttribute {
+    static constexpr uint32_t location = 2;
+    static constexpr VkFormat format = VK_FORMAT_R16G16_UNORM;
+    static constexpr uint32_t size = 2 * sizeof(uint16_t);
+    static constexpr bool quantized = true;
+
+    static void encode(const Vertex& vertex, const VertexQuantization& quantization, uint8_t* destination) {
+        uint16_t components[2];
+        for (int i = 0; i < 2; ++i) {
+            components[i] = quantize_unorm16(vertex.tex_coord[i], quantization.tex_coord_offset[i], quantization.tex_coord_scale[i]);
+        }
+        std::memcpy(destination, components, size);
+    }
+};
+
+// Vertex buffer layout with the attributes packed tightly in the order they are listed,
+// vertices are converted into it from Vertex when they are uploaded
+template<typename... Attributes>
+struct VertexLayout {
+    static constexpr uint32_t stride = (Attributes::size + ...);
+    static constexpr bool quantized = (Attributes::quantized || ...);
+
+    static constexpr VkVertexInputBindingDescription get_binding_description() {
+        VkVertexInputBindingDescription binding_description{};
+        binding_description.binding = 0;
+        binding_description.stride = stride;
+        binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return binding_description;
+    }
+
+    static constexpr auto get_attribute_description() {
+        std::array<VkVertexInputAttributeDescription, sizeof...(Attributes)> attribute_descriptions{};
+
+        uint32_t i = 0;
+        uint32_t offset = 0;
+        ((attribute_descriptions[i++] = {Attributes::location, 0, Attributes::format, offset}, offset += Attributes::size), ...);
+
+        return attribute_descriptions;
+    }
+
+    // Identity unless an attribute is quantized
+    static VertexQuantization get_quantization(const Vertex* vertices, uint32_t vertex_count) {
+        if constexpr (quantized) {
+            return compute_vertex_quantization(vertices, vertex_count);
+        } else {
+            return VertexQuantization{};
+        }
+    }
+
+    // Writes vertex_count * stride bytes
+    static void encode(const Vertex* vertices, uint32_t vertex_count, const VertexQuantization& quantization, void* destination) {
+        auto bytes = static_cast<uint8_t*>(destination);
+        for (uint32_t i = 0; i < vertex_count; ++i) {
+            ((Attributes::encode(vertices[i], quantization, bytes), bytes += Attributes::size), ...);
+        }
+    }
+};
+
+// Byte for byte the layout of Vertex, 32 bytes
+using FullVertexLayout = VertexLayout<PositionAttribute, ColorAttribute, TexCoordAttribute>;
+static_assert(FullVertexLayout::stride == sizeof(Vertex));
+
+// 12 bytes, positions and texture coordinates quantized within the bounds of the mesh. The
+// color is always white and left out, the vertex shader substitutes it
+using CompactVertexLayout = VertexLayout<QuantizedPositionAttribute, QuantizedTexCoordAttribute>;
+
+// Chosen with the VERTEX_LAYOUT CMake option, the vertex shader is compiled to match
+#ifdef COMPACT_VERTEX_LAYOUT
+using GpuVertexLayout = CompactVertexLayout;
+constexpr const char* gpu_vertex_layout_name = "compact";
+#else
+using GpuVertexLayout = FullVertexLayout;
+constexpr const char* gpu_vertex_layout_name = "full";
+#endif
+
+#endif